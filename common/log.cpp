@@ -10,6 +10,8 @@
 #include "spdlog/sinks/msvc_sink.h"
 #include "spdlog/sinks/null_sink.h"
 #include "utilities/common_util.h"
+#include "utilities/thread_affinity.h"
+#include "placement.h"
 #include "spdlog/logger.h"
 #include <map>
 #include <algorithm>
@@ -183,7 +185,12 @@ bool init_log_conf(const char* conffile)
     {
       int thread_pool_queue_size = config["thread_pool_queue_size"].as<int>();
       int thread_pool_thread_count = config["thread_pool_thread_count"].as<int>();
-      spdlog::init_thread_pool(thread_pool_queue_size, thread_pool_thread_count);
+      std::vector<uint32> cpus = get_log_worker_cpus();
+      spdlog::init_thread_pool(thread_pool_queue_size, thread_pool_thread_count,
+        [cpus]()
+        {
+          set_current_thread_affinity(cpus);
+        });
     }
 
     if (!config["sinks"])
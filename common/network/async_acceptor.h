@@ -15,16 +15,22 @@ using boost::asio::ip::tcp;
 #define MAX_LISTEN_CONNECTIONS boost::asio::socket_base::max_connections
 #endif
 
+#ifdef SO_REUSEPORT
+typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> socket_reuse_port;
+#endif
+
 class TCPAsyncAcceptor
 {
 public:
   typedef void(*AcceptCallback)(tcp::socket&& newsocket_, uint32 thread_index);
+  typedef std::function<void(tcp::socket&& newsocket_, uint32 thread_index)> AcceptHandler;
   TCPAsyncAcceptor(common::asio::IoContext& io_context,
     std::string const& bind_ip, uint16 port) :
     acceptor_(io_context),
     endpoint_(common::net::make_address(bind_ip), port),
     socket_(io_context),
     closed_(false),
+    reuse_port_(false),
     socket_Factory_(std::bind(&TCPAsyncAcceptor::defeault_socket_factory, this))
   {
 
@@ -35,19 +41,26 @@ public:
 
   template<AcceptCallback acceptCallback>
   void async_accept_with_callback()
+  {
+    async_accept_with_callback(AcceptHandler(acceptCallback));
+  }
+
+  /// Accepts into the socket given by the socket factory and calls handler with it, then
+  /// waits for the next connection until close().
+  void async_accept_with_callback(AcceptHandler handler)
   {
     tcp::socket* socket;
     uint32 thread_index;
     std::tie(socket, thread_index) = socket_Factory_();
     acceptor_.async_accept(*socket,
-      [this, socket, thread_index](boost::system::error_code error)
+      [this, socket, thread_index, handler = std::move(handler)](boost::system::error_code error) mutable
       {
         if (!error)
         {
           try
           {
             socket->non_blocking(true);
-            acceptCallback(std::move(*socket), thread_index);
+            handler(std::move(*socket), thread_index);
           }
           catch (boost::system::system_error const& err)
           {
@@ -57,10 +70,16 @@ public:
         }
 
         if (!closed_)
-          this->async_accept_with_callback<acceptCallback>();
+          this->async_accept_with_callback(std::move(handler));
       });
   }
 
+  /// Lets several acceptors listen on the same port (SO_REUSEPORT), must be set before bind().
+  void set_reuse_port(bool enable)
+  {
+    reuse_port_ = enable;
+  }
+
   bool bind()
   {
     boost::system::error_code error_code;
@@ -72,6 +91,23 @@ public:
       return false;
     }
 
+    if (reuse_port_)
+    {
+#ifdef SO_REUSEPORT
+      acceptor_.set_option(tcp::acceptor::reuse_address(true), error_code);
+      if (!error_code)
+        acceptor_.set_option(socket_reuse_port(true), error_code);
+#else
+      error_code = boost::asio::error::operation_not_supported;
+#endif
+      if (error_code)
+      {
+        LOG_INFO("network", "Failed to enable SO_REUSEPORT on acceptor {}",
+          error_code.message().c_str());
+        return false;
+      }
+    }
+
     acceptor_.bind(endpoint_, error_code);
     if (error_code)
     {
@@ -120,6 +156,7 @@ private:
   tcp::endpoint endpoint_;
   tcp::socket socket_;
   std::atomic<bool> closed_;
+  bool reuse_port_;
   std::function<std::pair<tcp::socket*, uint32>()> socket_Factory_;
 };
 
@@ -0,0 +1,80 @@
+#ifndef __frame_decoder_h__
+#define __frame_decoder_h__
+#include "define.h"
+#include "byte_converter.h"
+#include "message_buffer.h"
+#include <cstring>
+
+/// A complete frame payload inside the socket read buffer, valid until the buffer is read again.
+struct FrameView
+{
+  uint8 const* data;
+  std::size_t size;
+};
+
+enum FrameDecodeResult
+{
+  FRAME_DECODE_NEED_MORE,   // every complete frame was handled, wait for more bytes
+  FRAME_DECODE_STOPPED,     // the frame handler asked to stop
+  FRAME_DECODE_INVALID      // the length prefix exceeds the frame size limit
+};
+
+/**
+  * @name   FrameDecoder
+  * @brief  Splits a stream of length-prefixed frames ([LengthType payload size][payload]) in place.
+  *         Every complete frame is handed out as a view into the read buffer, bytes are only
+  *         moved when a partial frame is left at the end of the buffer (MessageBuffer::normalize
+  *         before the next read).
+*/
+template<typename LengthType = uint16>
+class FrameDecoder
+{
+public:
+  static std::size_t const HEADER_SIZE = sizeof(LengthType);
+
+  /// Frames with a payload above max_frame_size make decode() return FRAME_DECODE_INVALID,
+  /// it bounds the read buffer a peer can make the socket grow to.
+  explicit FrameDecoder(std::size_t max_frame_size) : max_frame_size_(max_frame_size) { }
+
+  void set_max_frame_size(std::size_t size) { max_frame_size_ = size; }
+
+  /// Calls handler(FrameView const&) for each complete frame, a false return stops decoding
+  /// (the current frame is consumed). Buffer is MessageBuffer or RingMessageBuffer.
+  template<typename Buffer, typename Handler>
+  FrameDecodeResult decode(Buffer& buffer, Handler&& handler)
+  {
+    while (buffer.get_active_size() >= HEADER_SIZE)
+    {
+      LengthType length;
+      std::memcpy(&length, buffer.get_read_pointer(), HEADER_SIZE);
+      endian_convert(length);
+      if (length > max_frame_size_)
+        return FRAME_DECODE_INVALID;
+
+      std::size_t frame_size = HEADER_SIZE + length;
+      if (buffer.get_active_size() < frame_size)
+      {
+        // the frame straddles the end of the buffer, make sure the rest of it fits
+        if (buffer.get_buffer_size() < frame_size)
+        {
+          buffer.normalize();
+          buffer.resize(SlabPool::round_size(frame_size));
+        }
+
+        return FRAME_DECODE_NEED_MORE;
+      }
+
+      FrameView frame = { buffer.get_read_pointer() + HEADER_SIZE, length };
+      buffer.read_completed(frame_size);
+      if (!handler(frame))
+        return FRAME_DECODE_STOPPED;
+    }
+
+    return FRAME_DECODE_NEED_MORE;
+  }
+
+private:
+  std::size_t max_frame_size_;
+};
+
+#endif // __frame_decoder_h__
@@ -26,6 +26,8 @@ namespace common
       operator IoContextBaseNamespace::IoContextBase const&() const { return impl_; }
 
       std::size_t run() { return impl_.run(); }
+      std::size_t run_one() { return impl_.run_one(); }
+      std::size_t poll() { return impl_.poll(); }
       void stop() { impl_.stop(); }
 
 #if BOOST_VERSION >= 106600
@@ -36,6 +38,24 @@ namespace common
       IoContextBaseNamespace::IoContextBase impl_;
     };
 
+    /// Name of the reactor asio was built with (see WITH_IO_URING).
+    inline char const* get_reactor_name()
+    {
+#if defined(BOOST_ASIO_HAS_IO_URING_AS_DEFAULT)
+      return "io_uring";
+#elif defined(BOOST_ASIO_HAS_IOCP)
+      return "iocp";
+#elif defined(BOOST_ASIO_HAS_EPOLL)
+      return "epoll";
+#elif defined(BOOST_ASIO_HAS_KQUEUE)
+      return "kqueue";
+#elif defined(BOOST_ASIO_HAS_DEV_POLL)
+      return "/dev/poll";
+#else
+      return "select";
+#endif
+    }
+
     template<typename T>
     inline decltype(auto) post(IoContextBaseNamespace::IoContextBase& ioContext, T&& t)
     {
@@ -46,6 +66,16 @@ namespace common
 #endif
     }
 
+    template<typename IoObject, typename T>
+    inline decltype(auto) post_to(IoObject& ioObject, T&& t)
+    {
+#if BOOST_VERSION >= 106600
+      return boost::asio::post(ioObject.get_executor(), std::forward<T>(t));
+#else
+      return ioObject.get_io_service().post(std::forward<T>(t));
+#endif
+    }
+
     template<typename T>
     inline decltype(auto) get_io_context(T&& ioObject)
     {
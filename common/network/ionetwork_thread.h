@@ -1,26 +1,39 @@
 #ifndef __network_thread_h__
 #define __network_thread_h__
 #include "define.h"
+#include "common_util.h"
+#include "async_acceptor.h"
 #include "deadline_timer.h"
 #include "errors.h"
 #include "io_context.h"
 #include "log.h"
+#include "thread_affinity.h"
+#include "timer_wheel.h"
 #include <boost/asio/ip/tcp.hpp>
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <thread>
+#include <utility>
 
 using boost::asio::ip::tcp;
 
+#define NETWORK_LOAD_SAMPLE_MS 1000
+#define MIGRATION_MAX_SOCKETS 32
+
 template<class SocketType>
 class IONetworkThread
 {
 public:
-  IONetworkThread() : connections_(0), stopped_(false), thread_(nullptr), io_context_(1),
-    accept_socket_(io_context_), update_timer_(io_context_)
+  IONetworkThread() : connections_(0), read_buffer_bytes_(0), write_queue_bytes_(0),
+    sockets_above_watermark_(0), stopped_(false), thread_(nullptr), io_context_(1),
+    accept_socket_(io_context_), update_timer_(io_context_), update_interval_(10), acceptor_(nullptr),
+    timer_wheel_(10, get_steady_ms()), busy_poll_us_(0), spin_time_us_(0), blocked_time_us_(0),
+    bytes_per_sec_(0), cpu_load_(0), load_sample_ms_(get_steady_ms()), load_sample_cpu_us_(0),
+    load_sample_spin_us_(0), migration_target_(nullptr), migration_budget_(0)
   {
   }
 
@@ -31,14 +44,52 @@ public:
     {
       wait();
     }
+
+    delete acceptor_;
   }
 
   void stop()
   {
     stopped_ = true;
+    if (acceptor_)
+      acceptor_->close();
     io_context_.stop();
   }
 
+  /// Opens a SO_REUSEPORT acceptor on this thread's io_context, accepted sockets never
+  /// leave the thread. Must be called before start().
+  bool start_acceptor(std::string const& bind_ip, uint16 port, uint32 thread_index,
+    TCPAsyncAcceptor::AcceptHandler handler)
+  {
+    ASSERT(!acceptor_ && !thread_);
+    TCPAsyncAcceptor* acceptor = nullptr;
+    try
+    {
+      acceptor = new TCPAsyncAcceptor(io_context_, bind_ip, port);
+    }
+    catch (boost::system::system_error const& err)
+    {
+      LOG_ERROR("network", "Exception caught in IONetworkThread.start_acceptor ({}:{}): {}",
+        bind_ip.c_str(), port, err.what());
+      return false;
+    }
+
+    acceptor->set_reuse_port(true);
+    if (!acceptor->bind())
+    {
+      delete acceptor;
+      return false;
+    }
+
+    acceptor->set_socket_factory([this, thread_index]()
+      {
+        return std::make_pair(&accept_socket_, thread_index);
+      });
+    acceptor->async_accept_with_callback(std::move(handler));
+    acceptor_ = acceptor;
+    return true;
+  }
+
   bool start()
   {
     if (thread_)
@@ -62,6 +113,61 @@ public:
     return connections_;
   }
 
+  /// Spin-then-block: keep polling the io_context for up to microseconds after the last
+  /// handler ran before blocking in the kernel. 0 (default) blocks right away. Set before start().
+  void set_busy_poll(uint32 microseconds) { busy_poll_us_ = microseconds; }
+
+  /// Pins the thread to the given cpus when it starts. Set before start().
+  void set_cpu_affinity(std::vector<uint32> const& cpus) { cpu_affinity_ = cpus; }
+
+  /// Time spent spinning in empty polls and blocked waiting for work (busy poll mode only).
+  uint64 get_spin_time_us() const { return spin_time_us_; }
+  uint64 get_blocked_time_us() const { return blocked_time_us_; }
+
+  /// Traffic of this thread's sockets and its cpu usage in permille (spinning excluded),
+  /// sampled every NETWORK_LOAD_SAMPLE_MS.
+  uint64 get_bytes_per_sec() const { return bytes_per_sec_; }
+  uint32 get_cpu_load() const { return cpu_load_; }
+
+  /// Asks the thread to move sockets carrying up to bytes_per_sec of traffic to target at its
+  /// next load sample. Thread-safe, replaces a request that was not acted on yet.
+  void request_migration(IONetworkThread* target, uint64 bytes_per_sec)
+  {
+    std::lock_guard<std::mutex> lock(migration_lock_);
+    migration_target_ = target;
+    migration_budget_ = bytes_per_sec;
+  }
+
+  /// Takes over a socket handed off by another network thread, the descriptor is moved to
+  /// this thread's reactor by a handler running on it.
+  void adopt_socket(std::shared_ptr<SocketType> sock)
+  {
+    ++connections_;
+    sock->hand_off(io_context_);
+    post([this, sock]()
+      {
+        if (!sock->complete_migration(io_context_, &timer_wheel_))
+        {
+          --connections_;
+          return;
+        }
+
+        sockets_.push_back(sock);
+        socket_added(sock);
+      });
+  }
+
+  /// Read buffer memory held by this thread's sockets, sampled every update tick.
+  std::size_t get_read_buffer_bytes() const
+  {
+    return read_buffer_bytes_;
+  }
+
+  /// Bytes queued for writing on this thread's sockets and how many of them are above their
+  /// high watermark, sampled every update tick.
+  std::size_t get_write_queue_bytes() const { return write_queue_bytes_; }
+  uint32 get_sockets_above_watermark() const { return sockets_above_watermark_; }
+
   virtual void add_socket(std::shared_ptr<SocketType> sock)
   {
     std::lock_guard<std::mutex> lock(new_sockets_lock_);
@@ -71,7 +177,18 @@ public:
   }
 
   tcp::socket* get_socket_for_accept() { return &accept_socket_; }
+
+  template<typename Handler>
+  void post(Handler&& handler)
+  {
+    common::asio::post(io_context_, std::forward<Handler>(handler));
+  }
+
+  /// Housekeeping tick in milliseconds. Sockets that flush on queue do not depend
+  /// on it for sending, so it can be raised to keep idle threads asleep.
+  void set_update_interval(uint32 milliseconds) { update_interval_ = milliseconds ? milliseconds : 1; }
 protected:
+  /// Also called when a socket migrates in (socket_added) or out (socket_removed).
   virtual void socket_added(std::shared_ptr<SocketType> /*sock*/) { }
   virtual void socket_removed(std::shared_ptr<SocketType> /*sock*/) { }
 
@@ -95,6 +212,7 @@ protected:
       }
       else
       {
+        sock->attach_network_thread(io_context_, &timer_wheel_);
         sockets_.push_back(sock);
       }
     }
@@ -105,41 +223,209 @@ protected:
     std::stringstream ss;
     ss << std::this_thread::get_id();
     LOG_INFO("network", "network thread{} starting.", ss.str().c_str());
-    update_timer_.expires_from_now(boost::posix_time::milliseconds(10));
+    if (!set_current_thread_affinity(cpu_affinity_))
+      LOG_WARN("network", "network thread{} failed to set cpu affinity.", ss.str().c_str());
+    load_sample_ms_ = get_steady_ms();
+    load_sample_cpu_us_ = get_current_thread_cpu_us();
+
+    update_timer_.expires_from_now(boost::posix_time::milliseconds(update_interval_));
     update_timer_.async_wait(std::bind(&IONetworkThread<SocketType>::update, this));
-    io_context_.run();
+    if (busy_poll_us_)
+    {
+      run_busy_poll();
+      LOG_INFO("network", "network thread{} spin {}us blocked {}us.", ss.str().c_str(),
+        get_spin_time_us(), get_blocked_time_us());
+    }
+    else
+      io_context_.run();
     LOG_INFO("network", "network thread{} stoped.", ss.str().c_str());
+    for (std::shared_ptr<SocketType> const& sock : sockets_)
+      sock->detach_network_thread();
+    migrations_.clear();
     new_sockets_.clear();
     sockets_.clear();
   }
 
+  void run_busy_poll()
+  {
+    typedef std::chrono::steady_clock clock;
+    std::chrono::microseconds const spin_window(busy_poll_us_);
+    clock::time_point idle_since;
+    bool idle = false;
+    while (!stopped_)
+    {
+      if (io_context_.poll())
+      {
+        if (idle)
+        {
+          spin_time_us_ += elapsed_us(idle_since, clock::now());
+          idle = false;
+        }
+        continue;
+      }
+
+      clock::time_point now = clock::now();
+      if (!idle)
+      {
+        idle = true;
+        idle_since = now;
+        continue;
+      }
+
+      if (now - idle_since < spin_window)
+        continue;
+
+      // nothing arrived within the spin window, sleep in the reactor until the next handler
+      spin_time_us_ += elapsed_us(idle_since, now);
+      io_context_.run_one();
+      blocked_time_us_ += elapsed_us(now, clock::now());
+      idle = false;
+    }
+  }
+
+  static uint64 elapsed_us(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+  {
+    return uint64(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+  }
+
   void update()
   {
     if (stopped_)
       return;
 
-    update_timer_.expires_from_now(boost::posix_time::milliseconds(10));
+    update_timer_.expires_from_now(boost::posix_time::milliseconds(update_interval_));
     update_timer_.async_wait(std::bind(&IONetworkThread<SocketType>::update, this));
     add_new_sockets();
-    sockets_.erase(std::remove_if(sockets_.begin(), sockets_.end(), [this](std::shared_ptr<SocketType> sock)
+    uint64 now = get_steady_ms();
+    timer_wheel_.advance(now);
+    hand_off_migrations();
+
+    bool sample_load = now - load_sample_ms_ >= NETWORK_LOAD_SAMPLE_MS;
+    uint64 transferred = 0;
+    std::size_t read_buffer_bytes = 0;
+    std::size_t write_queue_bytes = 0;
+    uint32 above_watermark = 0;
+    sockets_.erase(std::remove_if(sockets_.begin(), sockets_.end(),
+      [this, sample_load, &transferred, &read_buffer_bytes, &write_queue_bytes, &above_watermark](std::shared_ptr<SocketType> sock)
       {
         if (!sock->update())
         {
           if (sock->is_open())
             sock->close_socket();
 
+          sock->detach_network_thread();
           this->socket_removed(sock);
           --this->connections_;
           return true;
         }
 
+        if (sample_load)
+          transferred += sock->sample_transferred_bytes();
+        read_buffer_bytes += sock->get_read_buffer().get_buffer_size();
+        write_queue_bytes += sock->get_queued_write_bytes();
+        if (sock->is_above_high_watermark())
+          ++above_watermark;
         return false;
       }), sockets_.end());
+    read_buffer_bytes_ = read_buffer_bytes;
+    write_queue_bytes_ = write_queue_bytes;
+    sockets_above_watermark_ = above_watermark;
+
+    if (sample_load)
+    {
+      uint64 elapsed_ms = now - load_sample_ms_;
+      uint64 cpu_us = get_current_thread_cpu_us();
+      uint64 spin_us = spin_time_us_;
+      uint64 busy_us = cpu_us - load_sample_cpu_us_;
+      busy_us -= std::min(busy_us, spin_us - load_sample_spin_us_);
+      bytes_per_sec_ = transferred * 1000 / elapsed_ms;
+      cpu_load_ = uint32(std::min<uint64>(busy_us / elapsed_ms, 1000));
+      load_sample_ms_ = now;
+      load_sample_cpu_us_ = cpu_us;
+      load_sample_spin_us_ = spin_us;
+      begin_migrations(elapsed_ms);
+    }
+  }
+
+  /// Picks the busiest sockets that fit the requested budget, largest first, so a single
+  /// hot connection is not bounced between threads.
+  void begin_migrations(uint64 elapsed_ms)
+  {
+    IONetworkThread* target = nullptr;
+    uint64 budget = 0;
+    {
+      std::lock_guard<std::mutex> lock(migration_lock_);
+      std::swap(target, migration_target_);
+      budget = migration_budget_;
+    }
+
+    if (!target || target == this || !migrations_.empty() || stopped_)
+      return;
+
+    SocketContainer candidates;
+    for (std::shared_ptr<SocketType> const& sock : sockets_)
+      if (sock->is_open() && sock->get_last_transferred_sample())
+        candidates.push_back(sock);
+
+    std::sort(candidates.begin(), candidates.end(),
+      [](std::shared_ptr<SocketType> const& left, std::shared_ptr<SocketType> const& right)
+      {
+        return left->get_last_transferred_sample() > right->get_last_transferred_sample();
+      });
+
+    for (std::shared_ptr<SocketType> const& sock : candidates)
+    {
+      uint64 rate = sock->get_last_transferred_sample() * 1000 / elapsed_ms;
+      if (rate > budget || !sock->begin_migration())
+        continue;
+
+      migrations_.push_back(std::make_pair(sock, target));
+      budget -= rate;
+      if (migrations_.size() >= MIGRATION_MAX_SOCKETS)
+        break;
+    }
+
+    if (!migrations_.empty())
+      LOG_DEBUG("network", "network thread migrating {} sockets ({} bytes/s left of budget)",
+        migrations_.size(), budget);
+  }
+
+  /// Hands migrating sockets whose cancelled I/O has completed to their new thread.
+  void hand_off_migrations()
+  {
+    migrations_.erase(std::remove_if(migrations_.begin(), migrations_.end(),
+      [this](std::pair<std::shared_ptr<SocketType>, IONetworkThread*> const& migration)
+      {
+        std::shared_ptr<SocketType> const& sock = migration.first;
+        if (!sock->is_migration_ready())
+          return false;
+
+        // closing sockets finish their writes here
+        if (!sock->is_open())
+        {
+          sock->cancel_migration();
+          return true;
+        }
+
+        auto itr = std::find(sockets_.begin(), sockets_.end(), sock);
+        if (itr == sockets_.end())
+          return true; // closed and removed meanwhile
+
+        sockets_.erase(itr);
+        sock->detach_network_thread();
+        this->socket_removed(sock);
+        --this->connections_;
+        migration.second->adopt_socket(sock);
+        return true;
+      }), migrations_.end());
   }
 
 private:
   typedef std::vector<std::shared_ptr<SocketType>> SocketContainer;
   std::atomic<int32> connections_;
+  std::atomic<std::size_t> read_buffer_bytes_;
+  std::atomic<std::size_t> write_queue_bytes_;
+  std::atomic<uint32> sockets_above_watermark_;
   std::atomic<bool> stopped_;
   std::thread* thread_;
   SocketContainer sockets_;
@@ -148,6 +434,22 @@ private:
   common::asio::IoContext io_context_;
   tcp::socket accept_socket_;
   common::asio::DeadlineTimer update_timer_;
+  uint32 update_interval_;
+  TCPAsyncAcceptor* acceptor_;
+  TimerWheel timer_wheel_;
+  uint32 busy_poll_us_;
+  std::vector<uint32> cpu_affinity_;
+  std::atomic<uint64> spin_time_us_;
+  std::atomic<uint64> blocked_time_us_;
+  std::atomic<uint64> bytes_per_sec_;
+  std::atomic<uint32> cpu_load_;
+  uint64 load_sample_ms_;
+  uint64 load_sample_cpu_us_;
+  uint64 load_sample_spin_us_;
+  std::mutex migration_lock_;
+  IONetworkThread* migration_target_;
+  uint64 migration_budget_;
+  std::vector<std::pair<std::shared_ptr<SocketType>, IONetworkThread*>> migrations_;
 };
 
 #endif // __network_thread_h__
@@ -1,20 +1,122 @@
 #ifndef _common_socket__H__
 #define _common_socket__H__
 #include "message_buffer.h"
+#include "shared_message_buffer.h"
+#include "ring_message_buffer.h"
+#include "mpsc_queue.h"
+#include "timer_wheel.h"
+#include "io_context.h"
+#include <algorithm>
 #include <atomic>
-#include <queue>
+#include <deque>
 #include <memory>
+#include <vector>
 #include <functional>
 #include <type_traits>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/version.hpp>
 #include "log.h"
+#include "errors.h"
+#ifndef BOOST_ASIO_HAS_IOCP
+#include <unistd.h>
+#endif
 using boost::asio::ip::tcp;
 
 #define READ_BLOCK_SIZE 4096
+#define READ_BUFFER_MIN_SIZE 256
+#define READ_BUFFER_MAX_SIZE (64 * 1024)
+/// Consecutive small reads before the read buffer shrinks, bursty peers keep their buffer.
+#define READ_BUFFER_SHRINK_READS 8
+#define WRITE_GATHER_MAX_BUFFERS 64
+/// Coalescing chunk size when the MSS cannot be queried (1500 byte MTU minus IPv4/TCP headers and timestamps).
+#define WRITE_COALESCE_CHUNK_SIZE 1448
+#ifdef TCP_MAXSEG
+typedef boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_MAXSEG> tcp_max_segment;
+#endif
+#ifdef TCP_CORK
+typedef boost::asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_CORK> tcp_cork;
+#endif
 #ifdef BOOST_ASIO_HAS_IOCP
 #define ASIO__USE_IOCP
 #endif
-template<class T, class Stream = tcp::socket>
+/// Live migration moves the descriptor with basic_socket::release(), which Boost.Asio has
+/// since 1.70, and relies on the reactor; older Boost and IOCP builds keep sockets on their
+/// accepting thread (begin_migration() returns false).
+#if !defined(ASIO__USE_IOCP) && BOOST_VERSION >= 107000
+#define SOCKET_HAS_MIGRATION
+#endif
+/// What a socket does with packets queued while its write queue is above the high watermark.
+enum WriteQueuePolicy
+{
+  WRITE_QUEUE_NOTIFY,     // only on_write_queue_watermark() is called
+  WRITE_QUEUE_DROP,       // non-critical packets are dropped
+  WRITE_QUEUE_DISCONNECT, // the socket is closed
+};
+
+/// How written packets are turned into segments, see Socket::set_flush_policy.
+enum SocketFlushPolicy
+{
+  FLUSH_NAGLE,     // kernel default, small writes wait for outstanding acks
+  FLUSH_IMMEDIATE, // TCP_NODELAY, every write goes out right away
+  FLUSH_CORKED,    // TCP_NODELAY plus TCP_CORK/MSG_MORE for the rest of the update() tick
+};
+
+/// Entry of Socket's write queue, either an owned MessageBuffer or a cursor into a shared payload.
+class SocketWriteBuffer
+{
+public:
+  SocketWriteBuffer() : owned_(0), chunk_(false) { }
+  SocketWriteBuffer(MessageBuffer&& buffer) : owned_(std::move(buffer)), chunk_(false) { }
+  SocketWriteBuffer(SharedMessageBuffer const& buffer) : owned_(0), shared_(buffer), chunk_(false) { }
+
+  /// Empty buffer that small packets are appended to, see Socket::set_write_coalescing.
+  static SocketWriteBuffer make_chunk(std::size_t capacity)
+  {
+    SocketWriteBuffer chunk{ MessageBuffer(capacity) };
+    chunk.chunk_ = true;
+    return chunk;
+  }
+
+  SocketWriteBuffer(SocketWriteBuffer&&) = default;
+  SocketWriteBuffer& operator=(SocketWriteBuffer&&) = default;
+
+  uint8 const* get_read_pointer() const
+  {
+    return shared_.empty() ? owned_.get_read_pointer() : shared_.get_read_pointer();
+  }
+
+  std::size_t get_active_size() const
+  {
+    return shared_.empty() ? owned_.get_active_size() : shared_.get_active_size();
+  }
+
+  void read_completed(std::size_t bytes)
+  {
+    if (shared_.empty())
+      owned_.read_completed(bytes);
+    else
+      shared_.read_completed(bytes);
+  }
+
+  /// Copies data behind the unsent bytes of a chunk. Never reallocates, so a write in flight
+  /// keeps pointing at valid memory; false if this is not a chunk or it is full.
+  bool append(uint8 const* data, std::size_t size)
+  {
+    if (!chunk_ || owned_.get_remaining_space() < size)
+      return false;
+
+    owned_.write(data, size);
+    return true;
+  }
+
+private:
+  MessageBuffer owned_;
+  SharedMessageBuffer shared_;
+  bool chunk_;
+};
+
+/// ReadBuffer is MessageBuffer or RingMessageBuffer (no normalize() memmove, for streaming peers).
+template<class T, class Stream = tcp::socket, class ReadBuffer = MessageBuffer>
 class Socket : public std::enable_shared_from_this<T>
 {
 public:
@@ -22,9 +124,20 @@ public:
     socket_(std::move(socket)),
     remote_address_(socket_.remote_endpoint().address()),
     remote_port_(socket_.remote_endpoint().port()),
-    read_buffer_(), closed_(false), closing_(false), is_writing_async_(false)
+    read_buffer_(0), closed_(false), closing_(false), is_writing_async_(false),
+    write_gather_count_(WRITE_GATHER_MAX_BUFFERS), flush_on_queue_(false), flush_pending_(false),
+    timer_wheel_(nullptr), read_idle_timeout_(0), write_idle_timeout_(0),
+    read_size_min_(READ_BUFFER_MIN_SIZE), read_size_max_(READ_BUFFER_MAX_SIZE),
+    last_read_size_(READ_BLOCK_SIZE), last_read_filled_(false), small_reads_(0), small_read_max_(0),
+    read_on_readiness_(false),
+    owner_context_(nullptr), migrating_(false), read_pending_(false), read_resume_(false),
+    custom_read_(false), bytes_read_(0), bytes_written_(0), transferred_sample_(0), last_sample_(0),
+    queued_bytes_(0), write_high_watermark_(0), write_low_watermark_(0),
+    write_queue_policy_(WRITE_QUEUE_NOTIFY), above_high_watermark_(false), high_watermark_notified_(false),
+    dropped_packets_(0), coalesce_size_(0), flush_policy_(FLUSH_NAGLE), corked_(false)
   {
-    read_buffer_.resize(READ_BLOCK_SIZE);
+    // the read buffer is allocated by the first async_read, on the owning network thread
+    write_buffers_.reserve(write_gather_count_);
   }
 
   virtual ~Socket()
@@ -38,20 +151,177 @@ public:
 
   virtual bool update()
   {
+    check_write_watermarks();
     if (closed_)
       return false;
 
-#ifndef ASIO__USE_IOCP
-    if (is_writing_async_ || (write_queue_.empty() && !closing_))
+    if (migrating_)
       return true;
 
-    for (; handle_queue();)
-      ;
+    take_queued_packets();
+#ifndef ASIO__USE_IOCP
+    if (!is_writing_async_ && (!write_queue_.empty() || closing_))
+      for (; handle_queue();)
+        ;
+#else
+    if (!write_queue_.empty())
+      async_process_queue();
+    else if (closing_)
+      close_socket();
 #endif
 
+    if (timer_wheel_ && write_idle_timeout_ && !write_queue_.empty() && !write_idle_timer_.is_scheduled())
+      timer_wheel_->schedule(write_idle_timer_, write_idle_timeout_);
+
+    // end of the tick, what the cork held back goes out now
+    if (corked_)
+      set_cork(false);
+
+    return true;
+  }
+
+  /// Called by the owning network thread, idle deadlines are tracked on its wheel and
+  /// flushes requested by queue_packet are posted to its io_context.
+  void attach_network_thread(IoContextBaseNamespace::IoContextBase& io_context, TimerWheel* wheel)
+  {
+    owner_context_.store(&io_context, std::memory_order_release);
+    timer_wheel_ = wheel;
+    read_idle_timer_.set_callback(std::bind(&Socket<T, Stream, ReadBuffer>::idle_timeout_handler, this, "read"));
+    write_idle_timer_.set_callback(std::bind(&Socket<T, Stream, ReadBuffer>::idle_timeout_handler, this, "write"));
+    if (read_idle_timeout_)
+      timer_wheel_->schedule(read_idle_timer_, read_idle_timeout_);
+  }
+
+  void detach_network_thread()
+  {
+    read_idle_timer_.cancel();
+    write_idle_timer_.cancel();
+    timer_wheel_ = nullptr;
+  }
+
+  /**
+    * @name   begin_migration
+    * @brief  First step of moving the socket to another network thread, called by the owner.
+    *         Pending reads and writability waits are cancelled and no new I/O is started
+    *         until complete_migration() ran on the new thread. Not supported without
+    *         SOCKET_HAS_MIGRATION and for sockets reading through async_read_with_callback.
+  */
+  bool begin_migration()
+  {
+#ifndef SOCKET_HAS_MIGRATION
+    return false;
+#else
+    if (!is_open() || migrating_ || custom_read_)
+      return false;
+
+    migrating_ = true;
+    boost::system::error_code error;
+    socket_.cancel(error);
+    return true;
+#endif
+  }
+
+  /// Gives up a begun migration, reading resumes on the current thread.
+  void cancel_migration()
+  {
+    migrating_ = false;
+    if (read_resume_)
+    {
+      read_resume_ = false;
+      async_read();
+    }
+  }
+
+  bool is_migrating() const { return migrating_; }
+
+  static constexpr bool supports_migration()
+  {
+#ifdef SOCKET_HAS_MIGRATION
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /// True once the cancelled operations completed, the owner may then hand the socket off.
+  bool is_migration_ready() const { return !read_pending_ && !is_writing_async_; }
+
+  /// Called by the old owner right before the socket is posted to io_context, flushes
+  /// requested from now on are routed there.
+  void hand_off(IoContextBaseNamespace::IoContextBase& io_context)
+  {
+    owner_context_.store(&io_context, std::memory_order_release);
+  }
+
+  /// Runs on the new network thread: moves the descriptor to its reactor and resumes
+  /// reading and writing. On failure the socket is closed and false is returned.
+  bool complete_migration(IoContextBaseNamespace::IoContextBase& io_context, TimerWheel* wheel)
+  {
+#ifndef SOCKET_HAS_MIGRATION
+    (void)io_context;
+    (void)wheel;
+    LOG_ERROR("network", "Socket::CompleteMigration: {} cannot be moved, live migration needs Boost 1.70 and a reactor (not IOCP)",
+      get_remote_ipaddress().to_string().c_str());
+    close_socket();
+    return false;
+#else
+    boost::system::error_code error;
+    tcp::socket::protocol_type protocol = socket_.local_endpoint(error).protocol();
+    if (!error)
+    {
+      tcp::socket::native_handle_type handle = socket_.release(error);
+      if (!error)
+      {
+        tcp::socket socket(io_context);
+        socket.assign(protocol, handle, error);
+        if (error)
+          ::close(handle);
+        else
+          socket_ = Stream(std::move(socket));
+      }
+    }
+
+    migrating_ = false;
+    if (!error && read_on_readiness_)
+      socket_.non_blocking(true, error);
+    if (error)
+    {
+      LOG_DEBUG("network", "Socket::CompleteMigration: failed to move {} - {} ({})",
+        get_remote_ipaddress().to_string().c_str(),
+        error.value(), error.message().c_str());
+      close_socket();
+      return false;
+    }
+
+    attach_network_thread(io_context, wheel);
+    if (read_resume_)
+    {
+      read_resume_ = false;
+      async_read();
+    }
+
+    take_queued_packets();
+    if (!is_writing_async_)
+      for (; handle_queue();)
+        ;
     return true;
+#endif
+  }
+
+  uint64 get_bytes_read() const { return bytes_read_; }
+  uint64 get_bytes_written() const { return bytes_written_; }
+
+  /// Bytes read and written since the previous call, sampled by the owning network thread.
+  uint64 sample_transferred_bytes()
+  {
+    uint64 total = bytes_read_ + bytes_written_;
+    last_sample_ = total - transferred_sample_;
+    transferred_sample_ = total;
+    return last_sample_;
   }
 
+  uint64 get_last_transferred_sample() const { return last_sample_; }
+
   boost::asio::ip::address get_remote_ipaddress() const
   {
     return remote_address_;
@@ -67,12 +337,43 @@ public:
     if (!is_open())
       return;
 
+    if (migrating_)
+    {
+      read_resume_ = true;
+      return;
+    }
+
+    read_pending_ = true;
+#ifndef ASIO__USE_IOCP
+    // a read that filled the buffer likely left data in the kernel, read it right away
+    if (read_on_readiness_ && !last_read_filled_)
+    {
+      // the wait holds no memory, a buffer without pending bytes goes back to the pool
+      // (a RingMessageBuffer frees its pages and keeps the mapping)
+      if (read_buffer_.get_buffer_size() && read_buffer_.get_active_size() == 0)
+      {
+        read_buffer_.shrink_to(0);
+        ASSERT(read_buffer_.get_buffer_size() == 0);
+      }
+
+#if BOOST_VERSION >= 106600
+      socket_.async_wait(tcp::socket::wait_read,
+#else
+      socket_.async_read_some(boost::asio::null_buffers(),
+#endif
+        std::bind(&Socket<T, Stream, ReadBuffer>::readable_handler,
+          this->shared_from_this(), std::placeholders::_1));
+      return;
+    }
+#endif
+
     read_buffer_.normalize();
+    adapt_read_buffer();
     read_buffer_.ensure_free_space();
     socket_.async_read_some(
       boost::asio::buffer(read_buffer_.get_write_pointer(),
         read_buffer_.get_remaining_space()),
-      std::bind(&Socket<T, Stream>::read_handler_internal,
+      std::bind(&Socket<T, Stream, ReadBuffer>::read_handler_internal,
         this->shared_from_this(),
         std::placeholders::_1, std::placeholders::_2));
   }
@@ -82,6 +383,7 @@ public:
     if (!is_open())
       return;
 
+    custom_read_ = true;
     read_buffer_.normalize();
     read_buffer_.ensure_free_space();
     socket_.async_read_some(
@@ -89,15 +391,24 @@ public:
       std::bind(callback, this->shared_from_this(), std::placeholders::_1, std::placeholders::_2));
   }
 
-  void queue_packet(MessageBuffer&& buffer)
+  /// Thread-safe, the packet is handed to the socket's network thread through an MPSC queue.
+  /// Packets that are not critical may be dropped under WRITE_QUEUE_DROP, see set_write_queue_limits.
+  void queue_packet(MessageBuffer&& buffer, bool critical = true)
   {
-    write_queue_.push(std::move(buffer));
+    enqueue_write(SocketWriteBuffer(std::move(buffer)), critical);
+  }
 
-#ifdef ASIO__USE_IOCP
-    async_process_queue();
-#endif
+  /// Queues a shared payload without copying its bytes, see SharedMessageBuffer.
+  void queue_packet(SharedMessageBuffer const& buffer, bool critical = true)
+  {
+    enqueue_write(SocketWriteBuffer(buffer), critical);
   }
 
+  /// Bytes queued and not yet written, including packets still in the MPSC queue.
+  std::size_t get_queued_write_bytes() const { return queued_bytes_; }
+  bool is_above_high_watermark() const { return above_high_watermark_; }
+  uint64 get_dropped_packets() const { return dropped_packets_; }
+
   bool is_open() const { return !closed_ && !closing_; }
 
   void close_socket()
@@ -116,10 +427,15 @@ public:
   }
 
   void delayed_close_socket() { closing_ = true; }
-  MessageBuffer& get_read_buffer() { return read_buffer_; }
+  ReadBuffer& get_read_buffer() { return read_buffer_; }
 protected:
   virtual void on_close() { }
   virtual void read_handler() = 0;
+
+  /// Called on the network thread when the queued bytes reach the high watermark (high) and
+  /// when they drain back to the low watermark (!high).
+  virtual void on_write_queue_watermark(bool /*high*/, std::size_t /*queued_bytes*/) { }
+
   bool async_process_queue()
   {
     if (is_writing_async_)
@@ -128,15 +444,14 @@ protected:
     is_writing_async_ = true;
 
 #ifdef ASIO__USE_IOCP
-    MessageBuffer& buffer = write_queue_.front();
-    socket_.async_write_some(boost::asio::buffer(buffer.get_read_pointer(),
-      buffer.get_active_size()),
-      std::bind(&Socket<T, Stream>::write_handler,
+    prepare_write_buffers();
+    socket_.async_write_some(write_buffers_,
+      std::bind(&Socket<T, Stream, ReadBuffer>::write_handler,
         this->shared_from_this(),
         std::placeholders::_1,
         std::placeholders::_2));
 #else
-    socket_.async_write_some(boost::asio::null_buffers(), std::bind(&Socket<T, Stream>::write_handler_wrapper,
+    socket_.async_write_some(boost::asio::null_buffers(), std::bind(&Socket<T, Stream, ReadBuffer>::write_handler_wrapper,
       this->shared_from_this(), std::placeholders::_1, std::placeholders::_2));
 #endif
 
@@ -153,6 +468,116 @@ protected:
         err_code.value(), err_code.message().c_str());
   }
 
+  /// FLUSH_CORKED corks the socket when the first packets of an update() tick are taken from
+  /// the queue and uncorks it once at the end of the tick, so every flush of the tick leaves
+  /// in full segments for two setsockopt calls. The tail waits up to one update interval
+  /// (the kernel caps it at 200ms). Sockets not attached to a network thread get no tick and
+  /// are uncorked when the write queue drains. Without TCP_CORK/MSG_MORE (non Linux, IOCP)
+  /// it behaves like FLUSH_IMMEDIATE.
+  void set_flush_policy(SocketFlushPolicy policy)
+  {
+    flush_policy_ = policy;
+    set_no_delay(policy != FLUSH_NAGLE);
+    if (policy != FLUSH_CORKED && corked_)
+      set_cork(false);
+  }
+
+  /// Sets how many queued buffers one write call may gather (writev), 1 disables gathering.
+  void set_write_gather_count(std::size_t count)
+  {
+    write_gather_count_ = count ? count : 1;
+    write_buffers_.reserve(write_gather_count_);
+  }
+
+  /// Packets up to half a chunk are copied into shared chunks of chunk_size bytes when the
+  /// network thread takes them from the queue, cutting iovecs and segments for chatty
+  /// protocols under set_no_delay(true). chunk_size 0 uses the connection's MSS.
+  void set_write_coalescing(bool enable, std::size_t chunk_size = 0)
+  {
+    if (!enable)
+    {
+      coalesce_size_ = 0;
+      return;
+    }
+
+    if (!chunk_size)
+    {
+      chunk_size = WRITE_COALESCE_CHUNK_SIZE;
+#ifdef TCP_MAXSEG
+      tcp_max_segment mss;
+      boost::system::error_code err_code;
+      socket_.get_option(mss, err_code);
+      if (!err_code && mss.value() > 0)
+        chunk_size = std::size_t(mss.value());
+#endif
+    }
+
+    coalesce_size_ = chunk_size;
+  }
+
+  /// When enabled queue_packet posts a flush to the socket's io_context instead of
+  /// waiting for the next update() tick. At most one flush is pending per socket.
+  void set_flush_on_queue(bool enable)
+  {
+    flush_on_queue_ = enable;
+  }
+
+  /// Closes the socket (delayed_close_socket) when nothing was read for read_idle_ms, or when
+  /// queued output made no progress for write_idle_ms. 0 disables a deadline.
+  void set_idle_timeout(uint32 read_idle_ms, uint32 write_idle_ms)
+  {
+    read_idle_timeout_ = read_idle_ms;
+    write_idle_timeout_ = write_idle_ms;
+    if (!timer_wheel_)
+      return;
+
+    if (read_idle_timeout_)
+      timer_wheel_->schedule(read_idle_timer_, read_idle_timeout_);
+    else
+      read_idle_timer_.cancel();
+
+    if (!write_idle_timeout_)
+      write_idle_timer_.cancel();
+  }
+
+  /// Limits the bytes a peer that stops reading can make the server hold. high 0 disables;
+  /// low defaults to half of high and must not exceed it.
+  void set_write_queue_limits(std::size_t high, std::size_t low = 0,
+    WriteQueuePolicy policy = WRITE_QUEUE_NOTIFY)
+  {
+    write_high_watermark_ = high;
+    write_low_watermark_ = (low && low <= high) ? low : high / 2;
+    write_queue_policy_ = policy;
+  }
+
+  /// Bounds of the adaptive read buffer: it doubles after a read that filled it and shrinks to
+  /// twice the largest of the last READ_BUFFER_SHRINK_READS reads once that many reads in a row
+  /// were small and all buffered data was consumed. min == max pins the size.
+  void set_read_buffer_limits(std::size_t min_size, std::size_t max_size)
+  {
+    read_size_min_ = min_size;
+    read_size_max_ = max_size < min_size ? min_size : max_size;
+  }
+
+  /// Idle sockets keep no read buffer: async_read() waits for readability and the buffer is
+  /// taken from the thread's slab pool only when data arrives, then given back once every
+  /// byte was consumed. Meant for large numbers of mostly idle clients (not on IOCP).
+  void set_read_on_readiness(bool enable)
+  {
+    boost::system::error_code err_code;
+    if (enable)
+      socket_.non_blocking(true, err_code);
+    if (err_code)
+    {
+      LOG_DEBUG("network", "Socket::SetReadOnReadiness: failed to make {} non-blocking - {} ({})",
+        get_remote_ipaddress().to_string().c_str(),
+        err_code.value(), err_code.message().c_str());
+      return;
+    }
+
+    read_on_readiness_ = enable;
+  }
+
   Stream& underlying_stream()
   {
     return socket_;
@@ -162,16 +587,320 @@ private:
   void read_handler_internal(boost::system::error_code error,
     size_t transferred_bytes)
   {
+    read_pending_ = false;
     if (error)
     {
-      close_socket();
+      if (!migration_cancelled(error))
+        close_socket();
       return;
     }
 
+    bytes_read_ += transferred_bytes;
     read_buffer_.write_completed(transferred_bytes);
+    last_read_size_ = transferred_bytes;
+    last_read_filled_ = read_buffer_.get_remaining_space() == 0;
+    if (timer_wheel_ && read_idle_timeout_)
+      timer_wheel_->schedule(read_idle_timer_, read_idle_timeout_);
     read_handler();
   }
 
+  void readable_handler(boost::system::error_code error)
+  {
+    read_pending_ = false;
+    if (error)
+    {
+      if (!migration_cancelled(error))
+        close_socket();
+      return;
+    }
+
+    if (!is_open())
+      return;
+
+    if (migrating_)
+    {
+      read_resume_ = true;
+      return;
+    }
+
+    read_buffer_.normalize();
+    if (read_buffer_.get_buffer_size() == 0)
+      read_buffer_.resize(SlabPool::round_size(
+        std::min(std::max(last_read_size_ * 2, read_size_min_), read_size_max_)));
+    read_buffer_.ensure_free_space();
+
+    boost::system::error_code read_error;
+    std::size_t transferred_bytes = socket_.read_some(
+      boost::asio::buffer(read_buffer_.get_write_pointer(), read_buffer_.get_remaining_space()),
+      read_error);
+    if (read_error == boost::asio::error::would_block || read_error == boost::asio::error::try_again)
+    {
+      async_read();
+      return;
+    }
+
+    read_handler_internal(read_error, transferred_bytes);
+  }
+
+  void adapt_read_buffer()
+  {
+    std::size_t size = read_buffer_.get_buffer_size();
+    std::size_t target = size;
+    if (size == 0)
+      target = std::min(std::max(std::size_t(READ_BLOCK_SIZE), read_size_min_), read_size_max_);
+    else if (last_read_filled_)
+    {
+      target = std::min(size * 2, read_size_max_);
+      small_reads_ = 0;
+      small_read_max_ = 0;
+    }
+    else if (read_buffer_.get_active_size() == 0)
+    {
+      // one large read in the window keeps the buffer, alternating peers do not resize it
+      small_read_max_ = std::max(small_read_max_, last_read_size_);
+      std::size_t shrunk = SlabPool::round_size(
+        std::min(std::max(small_read_max_ * 2, read_size_min_), read_size_max_));
+      if (shrunk >= size || ++small_reads_ >= READ_BUFFER_SHRINK_READS)
+      {
+        target = shrunk;
+        small_reads_ = 0;
+        small_read_max_ = 0;
+      }
+    }
+
+    target = SlabPool::round_size(target);
+    if (target > size)
+      read_buffer_.resize(target);
+    else if (target < size && read_buffer_.get_active_size() == 0)
+      read_buffer_.shrink_to(target);
+
+    last_read_filled_ = false;
+  }
+
+  /// A read aborted by begin_migration() is reissued on the new thread.
+  bool migration_cancelled(boost::system::error_code const& error)
+  {
+    if (!migrating_ || error != boost::asio::error::operation_aborted)
+      return false;
+
+    read_resume_ = true;
+    return true;
+  }
+
+  /// Runs on the owning thread at every tick and after every drain, producers only raise
+  /// above_high_watermark_ so drops start right away; callbacks and the disconnect policy
+  /// are applied here.
+  void check_write_watermarks()
+  {
+    if (!write_high_watermark_)
+      return;
+
+    std::size_t queued = queued_bytes_;
+    if (!high_watermark_notified_ && queued >= write_high_watermark_)
+    {
+      high_watermark_notified_ = true;
+      above_high_watermark_ = true;
+      on_write_queue_watermark(true, queued);
+      if (write_queue_policy_ == WRITE_QUEUE_DISCONNECT && !closed_)
+      {
+        LOG_DEBUG("network", "Socket::WriteQueue: {} has {} bytes queued, closing",
+          get_remote_ipaddress().to_string().c_str(), queued);
+        close_socket();
+      }
+    }
+    else if (high_watermark_notified_ && queued <= write_low_watermark_)
+    {
+      high_watermark_notified_ = false;
+      above_high_watermark_ = false;
+      on_write_queue_watermark(false, queued);
+    }
+    else if (!high_watermark_notified_ && above_high_watermark_.load(std::memory_order_relaxed))
+    {
+      // a producer crossed the mark and the queue drained before this thread looked
+      above_high_watermark_ = false;
+    }
+  }
+
+  void set_cork(bool enable)
+  {
+#ifdef TCP_CORK
+    // a closing socket is flushed by the shutdown
+    if (!is_open())
+      return;
+
+    boost::system::error_code err_code;
+    socket_.set_option(tcp_cork(enable), err_code);
+    if (err_code)
+    {
+      LOG_DEBUG("network", "Socket::SetCork: failed to set_option(TCP_CORK) for {} - {} ({})",
+        get_remote_ipaddress().to_string().c_str(),
+        err_code.value(), err_code.message().c_str());
+      return;
+    }
+
+    corked_ = enable;
+#else
+    (void)enable;
+#endif
+  }
+
+  /// Drops the front buffer of the write queue after a failed write.
+  void drop_write_front()
+  {
+    queued_bytes_ -= write_queue_.front().get_active_size();
+    write_queue_.pop_front();
+    uncork_if_drained();
+    check_write_watermarks();
+  }
+
+  /// Fallback for sockets no update() tick uncorks: nothing more to write, the partial
+  /// segment held back by the cork goes out now.
+  void uncork_if_drained()
+  {
+    if (corked_ && write_queue_.empty() && !owner_context_.load(std::memory_order_relaxed))
+      set_cork(false);
+  }
+
+  void idle_timeout_handler(char const* direction)
+  {
+    LOG_DEBUG("network", "Socket::IdleTimeout: {} {} idle timeout, closing",
+      get_remote_ipaddress().to_string().c_str(), direction);
+    delayed_close_socket();
+  }
+
+  void enqueue_write(SocketWriteBuffer&& buffer, bool critical)
+  {
+    if (above_high_watermark_.load(std::memory_order_relaxed) &&
+      (write_queue_policy_ == WRITE_QUEUE_DISCONNECT || (write_queue_policy_ == WRITE_QUEUE_DROP && !critical)))
+    {
+      ++dropped_packets_;
+      return;
+    }
+
+    std::size_t size = buffer.get_active_size();
+    std::size_t queued = queued_bytes_.fetch_add(size) + size;
+    if (write_high_watermark_ && queued >= write_high_watermark_)
+      above_high_watermark_ = true;
+
+    pending_queue_.enqueue(std::move(buffer));
+
+#ifdef ASIO__USE_IOCP
+    if (flush_pending_.exchange(true))
+#else
+    if (!flush_on_queue_ || flush_pending_.exchange(true))
+#endif
+      return;
+
+    // socket_ may be rebound by a migration, once attached the owner's context is used instead
+    IoContextBaseNamespace::IoContextBase* context = owner_context_.load(std::memory_order_acquire);
+    if (context)
+      common::asio::post(*context,
+        std::bind(&Socket<T, Stream, ReadBuffer>::flush_handler, this->shared_from_this(), context));
+    else
+      common::asio::post_to(socket_,
+        std::bind(&Socket<T, Stream, ReadBuffer>::flush_handler, this->shared_from_this(), context));
+  }
+
+  void take_queued_packets()
+  {
+    SocketWriteBuffer buffer;
+    while (pending_queue_.dequeue(buffer))
+    {
+      std::size_t size = buffer.get_active_size();
+      if (coalesce_size_ && size <= coalesce_size_ / 2)
+      {
+        if (write_queue_.empty() || !write_queue_.back().append(buffer.get_read_pointer(), size))
+        {
+          write_queue_.push_back(SocketWriteBuffer::make_chunk(coalesce_size_));
+          write_queue_.back().append(buffer.get_read_pointer(), size);
+        }
+        continue;
+      }
+
+      write_queue_.push_back(std::move(buffer));
+    }
+
+    // first packets of the tick, held until update() uncorks
+    if (flush_policy_ == FLUSH_CORKED && !corked_ && !write_queue_.empty())
+      set_cork(true);
+  }
+
+  void flush_handler(IoContextBaseNamespace::IoContextBase* context)
+  {
+    // posted before the socket moved, follow it to its new thread
+    IoContextBaseNamespace::IoContextBase* owner = owner_context_.load(std::memory_order_acquire);
+    if (owner && owner != context)
+    {
+      common::asio::post(*owner,
+        std::bind(&Socket<T, Stream, ReadBuffer>::flush_handler, this->shared_from_this(), owner));
+      return;
+    }
+
+    flush_pending_ = false;
+    if (closed_ || migrating_)
+      return;
+
+    take_queued_packets();
+#ifdef ASIO__USE_IOCP
+    if (!write_queue_.empty())
+      async_process_queue();
+#else
+    if (is_writing_async_)
+      return;
+
+    for (; handle_queue();)
+      ;
+#endif
+  }
+
+  std::size_t prepare_write_buffers()
+  {
+    std::size_t total = 0;
+    write_buffers_.clear();
+    for (auto itr = write_queue_.begin();
+      itr != write_queue_.end() && write_buffers_.size() < write_gather_count_; ++itr)
+    {
+      if (std::size_t size = itr->get_active_size())
+      {
+        write_buffers_.emplace_back(itr->get_read_pointer(), size);
+        total += size;
+      }
+    }
+
+    return total;
+  }
+
+  void write_queue_completed(std::size_t transferred_bytes)
+  {
+    bytes_written_ += transferred_bytes;
+    queued_bytes_ -= transferred_bytes;
+    while (!write_queue_.empty())
+    {
+      SocketWriteBuffer& buffer = write_queue_.front();
+      std::size_t size = buffer.get_active_size();
+      if (size > transferred_bytes)
+      {
+        buffer.read_completed(transferred_bytes);
+        break;
+      }
+
+      transferred_bytes -= size;
+      write_queue_.pop_front();
+    }
+
+    uncork_if_drained();
+
+    if (timer_wheel_ && write_idle_timeout_)
+    {
+      if (write_queue_.empty())
+        write_idle_timer_.cancel();
+      else
+        timer_wheel_->schedule(write_idle_timer_, write_idle_timeout_);
+    }
+
+    check_write_watermarks();
+  }
+
 #ifdef ASIO__USE_IOCP
 
   void write_handler(boost::system::error_code error,
@@ -180,9 +909,8 @@ private:
     if (!error)
     {
       is_writing_async_ = false;
-      write_queue_.front().read_completed(transferred_bytes);
-      if (!write_queue_.front().get_active_size())
-        write_queue_.pop();
+      write_queue_completed(transferred_bytes);
+      take_queued_packets();
 
       if (!write_queue_.empty())
         async_process_queue();
@@ -199,43 +927,53 @@ private:
     std::size_t /*transferedBytes*/)
   {
     is_writing_async_ = false;
-    HandleQueue();
+    if (migrating_)
+      return;
+
+    take_queued_packets();
+    handle_queue();
   }
 
   bool handle_queue()
   {
     if (write_queue_.empty())
+    {
+      if (closing_)
+        close_socket();
       return false;
+    }
 
-    MessageBuffer& queued_message = write_queue_.front();
-    std::size_t bytes_2_send = queued_message.get_active_size();
+    std::size_t bytes_2_send = prepare_write_buffers();
+    boost::asio::socket_base::message_flags flags = 0;
+#ifdef MSG_MORE
+    // more batches follow in this pass, let the kernel fill segments across them
+    if (flush_policy_ == FLUSH_CORKED && write_buffers_.size() < write_queue_.size())
+      flags = MSG_MORE;
+#endif
     boost::system::error_code error;
-    std::size_t bytes_sented = socket_.write_some(
-      boost::asio::buffer(queued_message.get_read_pointer(), bytes_2_send), error);
+    std::size_t bytes_sented = socket_.send(write_buffers_, flags, error);
     if (error)
     {
       if (error == boost::asio::error::would_block || error == boost::asio::error::try_again)
         return async_process_queue();
 
-      write_queue_.pop();
+      drop_write_front();
       if (closing_ && write_queue_.empty())
         close_socket();
       return false;
     }
     else if (bytes_sented == 0)
     {
-      write_queue_.pop();
+      drop_write_front();
       if (closing_ && write_queue_.empty())
         close_socket();
       return false;
     }
-    else if (bytes_sented < bytes_2_send) // now n > 0
-    {
-      queued_message.read_completed(bytes_sented);
+
+    write_queue_completed(bytes_sented);
+    if (bytes_sented < bytes_2_send) // now n > 0
       return async_process_queue();
-    }
 
-    write_queue_.pop();
     if (closing_ && write_queue_.empty())
       close_socket();
     return !write_queue_.empty();
@@ -246,11 +984,47 @@ private:
   Stream socket_;
   boost::asio::ip::address remote_address_;
   uint16 remote_port_;
-  MessageBuffer read_buffer_;
-  std::queue<MessageBuffer> write_queue_;
+  ReadBuffer read_buffer_;
+  MPSCQueue<SocketWriteBuffer> pending_queue_;
+  std::deque<SocketWriteBuffer> write_queue_;
+  std::vector<boost::asio::const_buffer> write_buffers_;
   std::atomic<bool> closed_;
   std::atomic<bool> closing_;
   bool is_writing_async_;
+  std::size_t write_gather_count_;
+  bool flush_on_queue_;
+  std::atomic<bool> flush_pending_;
+  TimerWheel* timer_wheel_;
+  TimerWheel::Timer read_idle_timer_;
+  TimerWheel::Timer write_idle_timer_;
+  uint32 read_idle_timeout_;
+  uint32 write_idle_timeout_;
+  std::size_t read_size_min_;
+  std::size_t read_size_max_;
+  std::size_t last_read_size_;
+  bool last_read_filled_;
+  uint32 small_reads_;
+  std::size_t small_read_max_;
+  bool read_on_readiness_;
+  std::atomic<IoContextBaseNamespace::IoContextBase*> owner_context_;
+  std::atomic<bool> migrating_;
+  bool read_pending_;
+  bool read_resume_;
+  bool custom_read_;
+  uint64 bytes_read_;
+  uint64 bytes_written_;
+  uint64 transferred_sample_;
+  uint64 last_sample_;
+  std::atomic<std::size_t> queued_bytes_;
+  std::size_t write_high_watermark_;
+  std::size_t write_low_watermark_;
+  WriteQueuePolicy write_queue_policy_;
+  std::atomic<bool> above_high_watermark_;
+  bool high_watermark_notified_;
+  std::atomic<uint64> dropped_packets_;
+  std::size_t coalesce_size_;
+  SocketFlushPolicy flush_policy_;
+  bool corked_;
 };
 
 #endif // _common_socket__H__
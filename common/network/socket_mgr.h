@@ -3,9 +3,17 @@
 #include "async_acceptor.h"
 #include "errors.h"
 #include "ionetwork_thread.h"
+#include "placement.h"
 #include <boost/asio/ip/tcp.hpp>
 #include <memory>
+#include <vector>
 using boost::asio::ip::tcp;
+enum RebalanceMetric
+{
+  REBALANCE_BY_BYTES,
+  REBALANCE_BY_CPU,
+};
+
 template<class SocketType>
 class TCPSocketMgr
 {
@@ -20,21 +28,25 @@ public:
   {
     ASSERT(thread_count > 0);
     TCPAsyncAcceptor* acceptor = nullptr;
-    try
-    {
-      acceptor = new TCPAsyncAcceptor(io_context, bind_ip, port);
-    }
-    catch (boost::system::system_error const& err)
+    if (!reuse_port_)
     {
-      LOG_ERROR("network", "Exception caught in SocketMgr.StartNetwork ({}:{}): {}",
-        bind_ip.c_str(), port, err.what());
-      return false;
-    }
+      try
+      {
+        acceptor = new TCPAsyncAcceptor(io_context, bind_ip, port);
+      }
+      catch (boost::system::system_error const& err)
+      {
+        LOG_ERROR("network", "Exception caught in SocketMgr.StartNetwork ({}:{}): {}",
+          bind_ip.c_str(), port, err.what());
+        return false;
+      }
 
-    if (!acceptor->bind())
-    {
-      LOG_ERROR("network", "start_network failed to bind socket acceptor");
-      return false;
+      if (!acceptor->bind())
+      {
+        LOG_ERROR("network", "start_network failed to bind socket acceptor");
+        delete acceptor;
+        return false;
+      }
     }
 
     acceptor_ = acceptor;
@@ -42,19 +54,52 @@ public:
     threads_ = start_threads();
     ASSERT(threads_);
 
+    TCPAsyncAcceptor::AcceptHandler on_accept = [this](tcp::socket&& sock, uint32 thread_index)
+    {
+      this->on_socket_open(std::move(sock), thread_index);
+    };
+
+    if (reuse_port_)
+    {
+      for (int32 i = 0; i < thread_count_; ++i)
+      {
+        if (!threads_[i].start_acceptor(bind_ip, port, i, on_accept))
+        {
+          LOG_ERROR("network", "start_network failed to bind reuse port acceptor of thread[{}]", i);
+          delete[] threads_;
+          threads_ = nullptr;
+          thread_count_ = 0;
+          return false;
+        }
+      }
+    }
+    else
+    {
+      // accept straight into a socket owned by the least loaded thread's io_context
+      acceptor_->set_socket_factory(std::bind(&TCPSocketMgr<SocketType>::get_socket_for_accept, this));
+      acceptor_->async_accept_with_callback(std::move(on_accept));
+    }
+
+    // explicit set_thread_affinity wins over the placement config
+    std::vector<std::vector<uint32>> const& affinity =
+      thread_affinity_.empty() ? get_network_thread_cpus() : thread_affinity_;
     for (int32 i = 0; i < thread_count_; ++i)
     {
+      threads_[i].set_busy_poll(busy_poll_us_);
+      if (std::size_t(i) < affinity.size())
+        threads_[i].set_cpu_affinity(affinity[i]);
       threads_[i].start();
     }
 
-    LOG_INFO("network", "start network thread[{}] host:{{}:{}}",
-      thread_count_, bind_ip.c_str(), port);
+    LOG_INFO("network", "start network thread[{}] host:{{}:{}} reactor:{}",
+      thread_count_, bind_ip.c_str(), port, common::asio::get_reactor_name());
     return true;
   }
 
   virtual void stop_network()
   {
-    acceptor_->close();
+    if (acceptor_)
+      acceptor_->close();
     if (thread_count_ != 0)
     {
       for (int32 i = 0; i < thread_count_; ++i)
@@ -88,8 +133,12 @@ public:
       ASSERT(thread_index < thread_count_, "thread index geater threadcount");
       std::shared_ptr<SocketType> new_socket =
         std::make_shared<SocketType>(std::move(sock));
-      new_socket->start();
       threads_[thread_index].add_socket(new_socket);
+      // the socket lives on the thread's io_context, so its first read is issued there too
+      threads_[thread_index].post([new_socket]()
+        {
+          new_socket->start();
+        });
     }
     catch (boost::system::system_error const& err)
     {
@@ -98,7 +147,81 @@ public:
     }
   }
 
+  /// Gives every network thread its own SO_REUSEPORT acceptor on the listen port so the
+  /// kernel balances accepts across threads. Must be set before start_network().
+  void set_reuse_port(bool enable) { reuse_port_ = enable; }
+
+  /// Network threads spin for microseconds before blocking, see IONetworkThread::set_busy_poll.
+  void set_busy_poll(uint32 microseconds) { busy_poll_us_ = microseconds; }
+
+  /// cpus[i] pins network thread i. Must be set before start_network().
+  void set_thread_affinity(std::vector<std::vector<uint32>> const& cpus) { thread_affinity_ = cpus; }
+
   int32 get_network_thread_count()const { return thread_count_; }
+
+  std::size_t get_read_buffer_bytes(int32 thread_index) const
+  {
+    return threads_[thread_index].get_read_buffer_bytes();
+  }
+
+  std::size_t get_write_queue_bytes(int32 thread_index) const
+  {
+    return threads_[thread_index].get_write_queue_bytes();
+  }
+
+  uint32 get_sockets_above_watermark(int32 thread_index) const
+  {
+    return threads_[thread_index].get_sockets_above_watermark();
+  }
+
+  /**
+    * @name   rebalance
+    * @brief  Migrates live connections from the busiest network thread to the least busy one
+    *         when their load differs by more than threshold_percent of the busiest. Sockets
+    *         worth about half the difference move at the busy thread's next load sample
+    *         (NETWORK_LOAD_SAMPLE_MS), so calling it every few seconds is enough. Does
+    *         nothing but log an error once without SOCKET_HAS_MIGRATION.
+  */
+  void rebalance(RebalanceMetric metric = REBALANCE_BY_CPU, uint32 threshold_percent = 25)
+  {
+    if (!SocketType::supports_migration())
+    {
+      static bool reported = false;
+      if (!reported)
+        LOG_ERROR("network", "SocketMgr::rebalance: live migration needs Boost 1.70 and a reactor (not IOCP), connections stay on their thread");
+      reported = true;
+      return;
+    }
+
+    if (thread_count_ < 2)
+      return;
+
+    auto load = [this, metric](int32 i) -> uint64
+    {
+      return metric == REBALANCE_BY_CPU ? threads_[i].get_cpu_load() : threads_[i].get_bytes_per_sec();
+    };
+
+    int32 busiest = 0;
+    int32 idlest = 0;
+    for (int32 i = 1; i < thread_count_; ++i)
+    {
+      if (load(i) > load(busiest))
+        busiest = i;
+      if (load(i) < load(idlest))
+        idlest = i;
+    }
+
+    uint64 high = load(busiest);
+    uint64 low = load(idlest);
+    if (busiest == idlest || (high - low) * 100 <= high * threshold_percent)
+      return;
+
+    // sockets are picked by traffic, express the cpu difference as a share of it
+    uint64 budget = threads_[busiest].get_bytes_per_sec() * (high - low) / (2 * high);
+    if (budget)
+      threads_[busiest].request_migration(&threads_[idlest], budget);
+  }
+
   uint32 select_thread_with_min_connections() const
   {
     uint32 min = 0;
@@ -115,11 +238,12 @@ public:
   std::pair<tcp::socket*, uint32> get_socket_for_accept()
   {
     uint32 thread_index = select_thread_with_min_connections();
-    return std::make_pair(threads_[threadIndex].get_socket_for_accept(), thread_index);
+    return std::make_pair(threads_[thread_index].get_socket_for_accept(), thread_index);
   }
 
 protected:
-  TCPSocketMgr() : acceptor_(nullptr), threads_(nullptr), thread_count_(0)
+  TCPSocketMgr() : acceptor_(nullptr), threads_(nullptr), thread_count_(0), reuse_port_(false),
+    busy_poll_us_(0)
   {
   }
 
@@ -128,6 +252,9 @@ protected:
   TCPAsyncAcceptor* acceptor_;
   IONetworkThread<SocketType>* threads_;
   int32 thread_count_;
+  bool reuse_port_;
+  uint32 busy_poll_us_;
+  std::vector<std::vector<uint32>> thread_affinity_;
 };
 
 #endif // __socket_mgr_h__
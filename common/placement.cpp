@@ -0,0 +1,83 @@
+#include "placement.h"
+#include "yaml-cpp/yaml.h"
+#include "utilities/thread_affinity.h"
+#include <iostream>
+
+static std::vector<uint32> main_thread_cpus;
+static std::vector<uint32> log_worker_cpus;
+static std::vector<std::vector<uint32>> network_thread_cpus;
+
+static std::vector<uint32> parse_cpus(const YAML::Node& node)
+{
+  if (node["cpus"])
+    return node["cpus"].as<std::vector<uint32>>();
+
+  if (node["numa_node"])
+  {
+    uint32 numa_node = node["numa_node"].as<uint32>();
+    std::vector<uint32> cpus = get_numa_node_cpus(numa_node);
+    if (cpus.empty())
+      std::cerr << "placement: numa node " << numa_node << " has no cpus, not pinned" << std::endl;
+    return cpus;
+  }
+
+  return std::vector<uint32>();
+}
+
+bool init_placement_conf(const char* conffile)
+{
+  if (conffile == nullptr || conffile[0] == 0)
+  {
+    std::cerr << "init_placement_conf: cant find conffile" << std::endl;
+    return false;
+  }
+
+  try
+  {
+    YAML::Node config = YAML::LoadFile(conffile);
+    YAML::Node placement = config["placement"];
+    if (!placement)
+      return true;
+
+    if (placement["main_thread"])
+      main_thread_cpus = parse_cpus(placement["main_thread"]);
+
+    if (placement["log_workers"])
+      log_worker_cpus = parse_cpus(placement["log_workers"]);
+
+    network_thread_cpus.clear();
+    if (placement["network_threads"])
+    {
+      for (auto itr = placement["network_threads"].begin(); itr != placement["network_threads"].end(); ++itr)
+        network_thread_cpus.push_back(parse_cpus(*itr));
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cout << "init_placement_conf exception: "
+      << e.what() << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+std::vector<uint32> const& get_main_thread_cpus()
+{
+  return main_thread_cpus;
+}
+
+std::vector<uint32> const& get_log_worker_cpus()
+{
+  return log_worker_cpus;
+}
+
+std::vector<std::vector<uint32>> const& get_network_thread_cpus()
+{
+  return network_thread_cpus;
+}
+
+bool apply_main_thread_placement()
+{
+  return set_current_thread_affinity(main_thread_cpus);
+}
@@ -0,0 +1,30 @@
+#ifndef __common_placement_h__
+#define __common_placement_h__
+#include "define.h"
+#include <vector>
+
+/**
+  * Thread placement, read from the "placement" section of a yaml file (the log config
+  * can carry it). Every entry is either a cpu list or a NUMA node:
+  *
+  *   placement:
+  *     main_thread: { cpus: [0] }
+  *     log_workers: { cpus: [1] }
+  *     network_threads:
+  *       - { numa_node: 0 }
+  *       - { cpus: [10, 11] }
+  *
+  * Must be loaded before init_log_conf and before the network starts. Pinned threads
+  * allocate their SlabPool blocks themselves, so first-touch keeps them node local, and
+  * blocks released on other threads go back to the allocating thread's cache.
+*/
+bool init_placement_conf(const char* conffile);
+
+std::vector<uint32> const& get_main_thread_cpus();
+std::vector<uint32> const& get_log_worker_cpus();
+/// Entry i belongs to network thread i, threads past the end are not pinned.
+std::vector<std::vector<uint32>> const& get_network_thread_cpus();
+
+/// Pins the calling thread with the main_thread entry, no-op when not configured.
+bool apply_main_thread_placement();
+#endif //__common_placement_h__
@@ -5,9 +5,71 @@
 #include <sstream>
 #include <time.h>
 #include <ctime>
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <immintrin.h>
+#define BYTEBUFFER_UNPACK_BMI2
+#endif
 
-ByteBuffer::ByteBuffer(MessageBuffer&& buffer) : rpos_(0), wpos_(0), bitpos_(InitialBitPos), curbitval_(0), storage_(buffer.move())
+namespace
 {
+#ifdef BYTEBUFFER_UNPACK_BMI2
+  /// Byte lanes selected by each packed uint64 mask, the pdep deposit masks.
+  struct PackedUint64Lanes
+  {
+    constexpr PackedUint64Lanes() : lanes()
+    {
+      for (uint32 mask = 0; mask < 256; ++mask)
+        for (uint32 i = 0; i < 8; ++i)
+          if (mask & (1 << i))
+            lanes[mask] |= UI64LIT(0xFF) << (i * 8);
+    }
+
+    uint64 lanes[256];
+  };
+
+  constexpr PackedUint64Lanes packed_lanes;
+
+  __attribute__((target("bmi2")))
+  uint64 unpack_uint64_bmi2(uint8 mask, uint8 const* src)
+  {
+    uint64 packed = 0;
+    std::memcpy(&packed, src, ByteBuffer::packed_uint64_size(mask));
+    return _pdep_u64(packed, packed_lanes.lanes[mask]);
+  }
+#endif
+
+  uint64 unpack_uint64_scalar(uint8 mask, uint8 const* src)
+  {
+    uint64 value = 0;
+    for (uint32 i = 0; i < 8; ++i)
+      if (mask & (uint8(1) << i))
+        value |= uint64(*src++) << (i * 8);
+    return value;
+  }
+
+  typedef uint64 (*UnpackUint64)(uint8, uint8 const*);
+
+  UnpackUint64 select_unpack_uint64()
+  {
+#ifdef BYTEBUFFER_UNPACK_BMI2
+    // pdep is microcoded before Zen 3, the scalar loop is the better choice there
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("bmi2") && !__builtin_cpu_is("amd"))
+      return unpack_uint64_bmi2;
+#endif
+    return unpack_uint64_scalar;
+  }
+}
+
+uint64 ByteBuffer::unpack_uint64(uint8 mask, uint8 const* src)
+{
+  static UnpackUint64 const unpack = select_unpack_uint64();
+  return unpack(mask, src);
+}
+
+ByteBuffer::ByteBuffer(MessageBuffer&& buffer) : rpos_(0), wpos_(0), bitpos_(InitialBitPos), curbitval_(0), size_(0), storage_(buffer.move())
+{
+  size_ = storage_.size();
 }
 
 ByteBufferPositionException::ByteBufferPositionException(size_t pos, size_t size, size_t valueSize)
@@ -23,23 +85,23 @@ ByteBufferPositionException::ByteBufferPositionException(size_t pos, size_t size
 
 ByteBuffer& ByteBuffer::operator>>(float& value)
 {
-  value = read<float>();
-  if (!std::isfinite(value))
-    throw ByteBufferException();
+  value = ByteBufferRead::finite(read<float>());
   return *this;
 }
 
 ByteBuffer& ByteBuffer::operator>>(double& value)
 {
-  value = read<double>();
-  if (!std::isfinite(value))
-    throw ByteBufferException();
+  value = ByteBufferRead::finite(read<double>());
   return *this;
 }
 
 uint32 ByteBuffer::read_packed_time()
 {
-  uint32 packedDate = read<uint32>();
+  return unpack_time(read<uint32>());
+}
+
+uint32 ByteBuffer::unpack_time(uint32 packedDate)
+{
   tm lt = tm();
   lt.tm_min = packedDate & 0x3F;
   lt.tm_hour = (packedDate >> 6) & 0x1F;
@@ -49,17 +111,6 @@ uint32 ByteBuffer::read_packed_time()
   return uint32(mktime(&lt));
 }
 
-void ByteBuffer::append(const uint8 *src, size_t cnt)
-{
-  ASSERT(src, "Attempted to put a NULL-pointer in ByteBuffer (pos: " SZFMTD " size: " SZFMTD ")", wpos_, size());
-  ASSERT(cnt, "Attempted to put a zero-sized value in ByteBuffer (pos: " SZFMTD " size: " SZFMTD ")", wpos_, size());
-  ASSERT(size() < 10000000);
-
-  flush_bits();
-  storage_.insert(storage_.begin() + wpos_, src, src + cnt);
-  wpos_ += cnt;
-}
-
 void ByteBuffer::append_packed_time(time_t time)
 {
 #ifdef _WIN32
@@ -2,10 +2,21 @@
 #define __byte_buffer_h__
 #include "define.h"
 #include "byte_converter.h"
+#include "errors.h"
+#include "slab_pool.h"
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <vector>
 #include <cstring>
 
+/// Sanity checks of the append hot path, compiled into debug builds or with BYTEBUFFER_CHECKED_APPEND.
+#if !defined(NDEBUG) || defined(BYTEBUFFER_CHECKED_APPEND)
+#define BYTEBUFFER_APPEND_ASSERT(cond, ...) ASSERT(cond, ##__VA_ARGS__)
+#else
+#define BYTEBUFFER_APPEND_ASSERT(cond, ...) ((void)0)
+#endif
+
 class MessageBuffer;
 class ByteBufferException : public std::exception
 {
@@ -29,6 +40,75 @@ public:
   ~ByteBufferPositionException() noexcept { }
 };
 
+/**
+  * @name   ByteBufferRead
+  * @brief  Checked reads over (data, size, rpos), the one implementation behind the reads of
+  *         ByteBuffer, ByteBufferView, ByteBufferReader and ByteBufferSchema. A read throws
+  *         ByteBufferPositionException when fewer bytes than it needs are left and otherwise
+  *         advances rpos past what it consumed. Bit state is left to the caller.
+*/
+struct ByteBufferRead
+{
+  static void require(size_t rpos, size_t len, size_t size)
+  {
+    if (rpos > size || len > size - rpos)
+      throw ByteBufferPositionException(rpos, len, size);
+  }
+
+  /// Value at pos, rpos is not moved.
+  template <typename T>
+  static T value(uint8 const* data, size_t size, size_t pos)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "read<T>() must be used with trivially copyable types");
+    require(pos, sizeof(T), size);
+    T val;
+    std::memcpy(&val, data + pos, sizeof(T));
+    endian_convert(val);
+    return val;
+  }
+
+  /// Rejects NaN and infinities, no client sends them on purpose.
+  template <typename T>
+  static T finite(T value)
+  {
+    if (!std::isfinite(value))
+      throw ByteBufferException();
+    return value;
+  }
+
+  static void bytes(uint8 const* data, size_t size, size_t& rpos, uint8* dest, size_t len)
+  {
+    require(rpos, len, size);
+    if (len)
+      std::memcpy(dest, data + rpos, len);
+    rpos += len;
+  }
+
+  static void skip(size_t size, size_t& rpos, size_t len)
+  {
+    require(rpos, len, size);
+    rpos += len;
+  }
+
+  static std::string string(uint8 const* data, size_t size, size_t& rpos, size_t length)
+  {
+    require(rpos, length, size);
+    if (!length)
+      return std::string();
+
+    std::string str(reinterpret_cast<char const*>(data + rpos), length);
+    rpos += length;
+    return str;
+  }
+
+  /// NUL terminated, a missing terminator takes the rest of the data.
+  static void cstring(uint8 const* data, size_t size, size_t& rpos, std::string& value);
+  static void skip_cstring(uint8 const* data, size_t size, size_t& rpos);
+
+  /// ORs the bytes following mask in the ByteBuffer::append_packed_uint64 format into value.
+  static void packed_uint64(uint8 const* data, size_t size, size_t& rpos, uint8 mask, uint64& value);
+};
+
 class ByteBuffer
 {
 public:
@@ -36,30 +116,34 @@ public:
   static uint8 const InitialBitPos = 8;
 
 
-  ByteBuffer() : rpos_(0), wpos_(0), bitpos_(InitialBitPos), curbitval_(0)
+  ByteBuffer() : rpos_(0), wpos_(0), bitpos_(InitialBitPos), curbitval_(0), size_(0)
   {
     storage_.reserve(DEFAULT_SIZE);
   }
 
-  ByteBuffer(size_t reserve) : rpos_(0), wpos_(0), bitpos_(InitialBitPos), curbitval_(0)
+  ByteBuffer(size_t reserve) : rpos_(0), wpos_(0), bitpos_(InitialBitPos), curbitval_(0), size_(0)
   {
     storage_.reserve(reserve);
   }
 
   ByteBuffer(ByteBuffer&& buf) noexcept : rpos_(buf.rpos_), wpos_(buf.wpos_),
-    bitpos_(buf.bitpos_), curbitval_(buf.curbitval_), storage_(buf.move()) { }
+    bitpos_(buf.bitpos_), curbitval_(buf.curbitval_), size_(buf.size_), storage_(buf.move()) { }
 
   ByteBuffer(ByteBuffer const& right) : rpos_(right.rpos_), wpos_(right.wpos_),
-    bitpos_(right.bitpos_), curbitval_(right.curbitval_), storage_(right.storage_) { }
+    bitpos_(right.bitpos_), curbitval_(right.curbitval_), size_(right.size_),
+    storage_(right.storage_.begin(), right.storage_.begin() + right.size_) { }
 
   ByteBuffer(MessageBuffer&& buffer);
 
-  std::vector<uint8>&& move() noexcept
+  /// Hands out the storage trimmed to size(), the grow-ahead slack is dropped without reallocating.
+  SlabByteVector&& move() noexcept
   {
+    storage_.resize(size_);
     rpos_ = 0;
     wpos_ = 0;
     bitpos_ = InitialBitPos;
     curbitval_ = 0;
+    size_ = 0;
     return std::move(storage_);
   }
 
@@ -71,7 +155,8 @@ public:
       wpos_ = right.wpos_;
       bitpos_ = right.bitpos_;
       curbitval_ = right.curbitval_;
-      storage_ = right.storage_;
+      size_ = right.size_;
+      storage_.assign(right.storage_.begin(), right.storage_.begin() + right.size_);
     }
 
     return *this;
@@ -85,6 +170,7 @@ public:
       wpos_ = right.wpos_;
       bitpos_ = right.bitpos_;
       curbitval_ = right.curbitval_;
+      size_ = right.size_;
       storage_ = right.move();
     }
     return *this;
@@ -98,6 +184,7 @@ public:
     wpos_ = 0;
     bitpos_ = InitialBitPos;
     curbitval_ = 0;
+    size_ = 0;
     storage_.clear();
   }
   template <typename T>
@@ -335,14 +422,9 @@ public:
 
   ByteBuffer &operator>>(std::string& value)
   {
-    value.clear();
-    while (rpos() < size())
-    {
-      char c = read<char>();
-      if (c == 0)
-        break;
-      value += c;
-    }
+    if (rpos_ < size())
+      reset_bitpos();
+    ByteBufferRead::cstring(storage_.data(), size(), rpos_, value);
     return *this;
   }
 
@@ -362,9 +444,9 @@ public:
 
   size_t rpos() const { return rpos_; }
 
-  size_t rpos(size_t rpos_)
+  size_t rpos(size_t rpos)
   {
-    rpos_ = rpos_;
+    rpos_ = rpos;
     return rpos_;
   }
 
@@ -375,9 +457,9 @@ public:
 
   size_t wpos() const { return wpos_; }
 
-  size_t wpos(size_t wpos_)
+  size_t wpos(size_t wpos)
   {
-    wpos_ = wpos_;
+    wpos_ = wpos;
     return wpos_;
   }
 
@@ -396,11 +478,8 @@ public:
 
   void read_skip(size_t skip)
   {
-    if (rpos_ + skip > size())
-      throw ByteBufferPositionException(rpos_, skip, size());
-
+    ByteBufferRead::skip(size(), rpos_, skip);
     reset_bitpos();
-    rpos_ += skip;
   }
 
   template <typename T>
@@ -415,11 +494,7 @@ public:
   template <typename T>
   T read(size_t pos) const
   {
-    if (pos + sizeof(T) > size())
-      throw ByteBufferPositionException(pos, sizeof(T), size());
-    T val = *((T const*)&storage_[pos]);
-    endian_convert(val);
-    return val;
+    return ByteBufferRead::value<T>(storage_.data(), size(), pos);
   }
 
   template<class T>
@@ -431,12 +506,8 @@ public:
 
   void read(uint8 *dest, size_t len)
   {
-    if (rpos_ + len > size())
-      throw ByteBufferPositionException(rpos_, len, size());
-
+    ByteBufferRead::bytes(storage_.data(), size(), rpos_, dest, len);
     reset_bitpos();
-    std::memcpy(dest, &storage_[rpos_], len);
-    rpos_ += len;
   }
 
   void read_packed_uint64(uint64& guid)
@@ -447,22 +518,37 @@ public:
 
   void read_packed_uint64(uint8 mask, uint64& value)
   {
-    for (uint32 i = 0; i < 8; ++i)
-      if (mask & (uint8(1) << i))
-        value |= (uint64(read<uint8>()) << (i * 8));
+    ByteBufferRead::packed_uint64(storage_.data(), size(), rpos_, mask, value);
+    reset_bitpos();
   }
 
-  std::string read_string(uint32 length)
+  /// Bytes following mask in the append_packed_uint64 format.
+  static size_t packed_uint64_size(uint8 mask)
   {
-    if (rpos_ + length > size())
-      throw ByteBufferPositionException(rpos_, length, size());
+    uint32 count = mask - ((mask >> 1) & 0x55);
+    count = (count & 0x33) + ((count >> 2) & 0x33);
+    return (count + (count >> 4)) & 0x0F;
+  }
 
-    reset_bitpos();
-    if (!length)
-      return std::string();
+  /**
+    * @name   unpack_uint64
+    * @brief  Decodes the packed_uint64_size(mask) bytes at src, unchecked. Uses BMI2 pdep with
+    *         a mask table when the CPU has it (checked once at runtime), a scalar loop otherwise.
+  */
+  static uint64 unpack_uint64(uint8 mask, uint8 const* src);
 
-    std::string str((char const*)&storage_[rpos_], length);
-    rpos_ += length;
+  /// Length of the NUL terminated string at data, size when it is not terminated. memchr is
+  /// the SSE2/AVX2 scan here, the C library picks the variant for the CPU at load time.
+  static size_t cstring_length(uint8 const* data, size_t size)
+  {
+    uint8 const* terminator = size ? static_cast<uint8 const*>(std::memchr(data, 0, size)) : nullptr;
+    return terminator ? size_t(terminator - data) : size;
+  }
+
+  std::string read_string(uint32 length)
+  {
+    std::string str = ByteBufferRead::string(storage_.data(), size(), rpos_, length);
+    reset_bitpos();
     return str;
   }
 
@@ -482,26 +568,33 @@ public:
 
   uint32 read_packed_time();
 
+  /// Local time of an append_packed_time value.
+  static uint32 unpack_time(uint32 packedDate);
+
   uint8* contents()
   {
-    if (storage_.empty())
+    if (!size_)
       throw ByteBufferException();
     return storage_.data();
   }
 
   uint8 const* contents() const
   {
-    if (storage_.empty())
+    if (!size_)
       throw ByteBufferException();
     return storage_.data();
   }
 
-  size_t size() const { return storage_.size(); }
-  bool empty() const { return storage_.empty(); }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
 
   void resize(size_t newsize)
   {
-    storage_.resize(newsize, 0);
+    if (newsize > storage_.size())
+      storage_.resize(newsize);
+    if (newsize > size_)
+      std::memset(storage_.data() + size_, 0, newsize - size_);
+    size_ = newsize;
     rpos_ = 0;
     wpos_ = size();
   }
@@ -523,7 +616,50 @@ public:
     return append((const uint8 *)src, cnt * sizeof(T));
   }
 
-  void append(const uint8 *src, size_t cnt);
+  void append(const uint8 *src, size_t cnt)
+  {
+    BYTEBUFFER_APPEND_ASSERT(src, "Attempted to put a NULL-pointer in ByteBuffer (pos: " SZFMTD " size: " SZFMTD ")", wpos_, size());
+    BYTEBUFFER_APPEND_ASSERT(cnt, "Attempted to put a zero-sized value in ByteBuffer (pos: " SZFMTD " size: " SZFMTD ")", wpos_, size());
+    std::memcpy(reserve_append(cnt), src, cnt);
+  }
+
+  /**
+    * @name   reserve_append
+    * @brief  Makes room for cnt bytes at wpos and returns where to write them, the bytes are
+    *         left uninitialized. The storage is grown ahead of size() geometrically, so a
+    *         single compare covers every field a caller then writes through the pointer
+    *         (see write_raw).
+  */
+  uint8* reserve_append(size_t cnt)
+  {
+    BYTEBUFFER_APPEND_ASSERT(size_ + cnt < 10000000);
+    flush_bits();
+    size_t pos = wpos_;
+    if (pos == size_)
+    {
+      if (storage_.size() - pos < cnt)
+        storage_.resize(std::max(pos + cnt, std::max(storage_.capacity(), storage_.size() * 2)));
+    }
+    else
+    {
+      // wpos was moved back with bitwpos(), the bytes behind it are shifted
+      storage_.insert(storage_.begin() + pos, cnt, uint8(0));
+    }
+
+    size_ += cnt;
+    wpos_ += cnt;
+    return storage_.data() + pos;
+  }
+
+  /// Stores value at a cursor obtained from reserve_append and returns the advanced cursor.
+  template <typename T>
+  static uint8* write_raw(uint8* cursor, T value)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "write_raw(uint8*, T) must be used with trivially copyable types");
+    endian_convert(value);
+    std::memcpy(cursor, &value, sizeof(value));
+    return cursor + sizeof(value);
+  }
 
   void append(const ByteBuffer& buffer)
   {
@@ -586,9 +722,42 @@ public:
 protected:
   size_t rpos_, wpos_, bitpos_;
   uint8 curbitval_;
-  std::vector<uint8> storage_;
+  /// Bytes in use, storage_ is grown ahead of it by reserve_append.
+  size_t size_;
+  SlabByteVector storage_;
 };
 
+inline void ByteBufferRead::cstring(uint8 const* data, size_t size, size_t& rpos, std::string& value)
+{
+  value.clear();
+  if (rpos >= size)
+    return;
+
+  size_t left = size - rpos;
+  size_t length = ByteBuffer::cstring_length(data + rpos, left);
+  value.assign(reinterpret_cast<char const*>(data + rpos), length);
+  rpos += length < left ? length + 1 : length;
+}
+
+inline void ByteBufferRead::skip_cstring(uint8 const* data, size_t size, size_t& rpos)
+{
+  if (rpos >= size)
+    return;
+
+  size_t left = size - rpos;
+  size_t length = ByteBuffer::cstring_length(data + rpos, left);
+  rpos += length < left ? length + 1 : length;
+}
+
+inline void ByteBufferRead::packed_uint64(uint8 const* data, size_t size, size_t& rpos, uint8 mask, uint64& value)
+{
+  size_t count = ByteBuffer::packed_uint64_size(mask);
+  require(rpos, count, size);
+  if (count)
+    value |= ByteBuffer::unpack_uint64(mask, data + rpos);
+  rpos += count;
+}
+
 template<> inline std::string ByteBuffer::read<std::string>()
 {
   std::string tmp;
@@ -599,8 +768,11 @@ template<> inline std::string ByteBuffer::read<std::string>()
 template<>
 inline void ByteBuffer::read_skip<char*>()
 {
-  std::string temp;
-  *this >> temp;
+  if (rpos_ >= size())
+    return;
+
+  reset_bitpos();
+  ByteBufferRead::skip_cstring(storage_.data(), size(), rpos_);
 }
 
 template<>
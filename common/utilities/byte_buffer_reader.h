@@ -0,0 +1,121 @@
+#ifndef __byte_buffer_reader_h__
+#define __byte_buffer_reader_h__
+#include "byte_buffer.h"
+#include <cstring>
+#include <string>
+
+/// Sanity checks of the unchecked reads, compiled into debug builds or with BYTEBUFFER_CHECKED_READ.
+#if !defined(NDEBUG) || defined(BYTEBUFFER_CHECKED_READ)
+#define BYTEBUFFER_READ_ASSERT(cond, ...) ASSERT(cond, ##__VA_ARGS__)
+#else
+#define BYTEBUFFER_READ_ASSERT(cond, ...) ((void)0)
+#endif
+
+/**
+  * @name   ByteBufferReader
+  * @brief  Read cursor over borrowed bytes (a FrameView, a MessageBuffer, a ByteBuffer) in the
+  *         ByteBuffer wire format. require(n) checks once that n bytes are left and throws
+  *         ByteBufferPositionException otherwise; the fixed size reads after it are unchecked
+  *         and only asserted in debug builds. Strings and packed guids have no size known up
+  *         front and stay checked, through ByteBufferRead like ByteBuffer's reads. The memory
+  *         must outlive the reader.
+  *
+  *           ByteBufferReader reader(packet.data, packet.size);
+  *           reader.require(sizeof(uint32) + 3 * sizeof(float));
+  *           uint32 id = reader.read<uint32>();
+  *           float x = reader.read<float>(); ...
+*/
+class ByteBufferReader
+{
+public:
+  ByteBufferReader() : data_(nullptr), size_(0), rpos_(0) { }
+
+  ByteBufferReader(uint8 const* data, size_t size) : data_(data), size_(size), rpos_(0) { }
+
+  /// Reads the unread bytes of buffer, from its rpos on, at rpos 0 like ByteBufferView(ByteBuffer const&).
+  /// buffer's own rpos is left alone.
+  explicit ByteBufferReader(ByteBuffer const& buffer) : data_(buffer.empty() ? nullptr : buffer.contents() + buffer.rpos()),
+    size_(buffer.size() - buffer.rpos()), rpos_(0) { }
+
+  void require(size_t size) const
+  {
+    ByteBufferRead::require(rpos_, size, size_);
+  }
+
+  bool can_read(size_t size) const { return size <= size_ - rpos_; }
+
+  /// Unchecked, call require() first.
+  template <typename T>
+  T read()
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "read<T>() must be used with trivially copyable types");
+    BYTEBUFFER_READ_ASSERT(can_read(sizeof(T)), "Unchecked read of " SZFMTD " bytes past the end of ByteBufferReader (pos: " SZFMTD " size: " SZFMTD ")", sizeof(T), rpos_, size_);
+    T value;
+    std::memcpy(&value, data_ + rpos_, sizeof(T));
+    endian_convert(value);
+    rpos_ += sizeof(T);
+    return value;
+  }
+
+  /// Unchecked, call require() first.
+  void read(uint8* dest, size_t len)
+  {
+    BYTEBUFFER_READ_ASSERT(can_read(len), "Unchecked read of " SZFMTD " bytes past the end of ByteBufferReader (pos: " SZFMTD " size: " SZFMTD ")", len, rpos_, size_);
+    if (len)
+      std::memcpy(dest, data_ + rpos_, len);
+    rpos_ += len;
+  }
+
+  /// Unchecked, call require() first.
+  void read_skip(size_t skip)
+  {
+    BYTEBUFFER_READ_ASSERT(can_read(skip), "Unchecked skip of " SZFMTD " bytes past the end of ByteBufferReader (pos: " SZFMTD " size: " SZFMTD ")", skip, rpos_, size_);
+    rpos_ += skip;
+  }
+
+  /// Unchecked like read<float>(), but rejects NaN and infinities as operator>>(float&) does.
+  float read_float()
+  {
+    return ByteBufferRead::finite(read<float>());
+  }
+
+  double read_double()
+  {
+    return ByteBufferRead::finite(read<double>());
+  }
+
+  /// Checked. NUL terminated like operator>>(std::string&), a missing terminator takes the rest.
+  void read_cstring(std::string& value)
+  {
+    ByteBufferRead::cstring(data_, size_, rpos_, value);
+  }
+
+  /// Checked.
+  std::string read_string(size_t length)
+  {
+    return ByteBufferRead::string(data_, size_, rpos_, length);
+  }
+
+  /// Checked, format of ByteBuffer::append_packed_uint64.
+  void read_packed_uint64(uint64& value)
+  {
+    uint8 mask = ByteBufferRead::value<uint8>(data_, size_, rpos_);
+    ++rpos_;
+    value = 0;
+    ByteBufferRead::packed_uint64(data_, size_, rpos_, mask, value);
+  }
+
+  uint8 const* data() const { return data_; }
+  uint8 const* get_read_pointer() const { return data_ + rpos_; }
+  size_t size() const { return size_; }
+  size_t rpos() const { return rpos_; }
+  size_t remaining() const { return size_ - rpos_; }
+  bool empty() const { return rpos_ == size_; }
+
+private:
+  uint8 const* data_;
+  size_t size_;
+  size_t rpos_;
+};
+
+#endif //__byte_buffer_reader_h__
@@ -0,0 +1,274 @@
+#ifndef __byte_buffer_schema_h__
+#define __byte_buffer_schema_h__
+#include "byte_buffer.h"
+#include "byte_buffer_reader.h"
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+/**
+  * @name   ByteBufferSchema
+  * @brief  Wire layout of a struct, declared once in field order:
+  *
+  *           struct MoveInfo { uint32 id; float x, y, z; uint64 guid; std::string name; };
+  *           template<> struct ByteBufferSchema<MoveInfo> : SchemaFields<
+  *             SCHEMA_FIELD(MoveInfo, id), SCHEMA_FIELD(MoveInfo, x), SCHEMA_FIELD(MoveInfo, y),
+  *             SCHEMA_FIELD(MoveInfo, z), SCHEMA_PACKED_UINT64(MoveInfo, guid),
+  *             SCHEMA_FIELD(MoveInfo, name)> { };
+  *
+  *         schema_write() emits the same bytes as the matching operator<< chain (strings NUL
+  *         terminated, guids as in append_packed_uint64) through one reserve_append for the
+  *         whole struct. schema_read() bounds checks each run of fixed size fields once.
+*/
+template<typename T>
+struct ByteBufferSchema;
+
+#define SCHEMA_FIELD(Class, member) SchemaField<Class, decltype(Class::member), &Class::member>
+#define SCHEMA_PACKED_UINT64(Class, member) SchemaPackedUint64<Class, decltype(Class::member), &Class::member>
+
+/// Read position of schema_read(), fields advance rpos.
+struct SchemaReadCursor
+{
+  uint8 const* data;
+  size_t size;
+  size_t rpos;
+
+  void require(size_t len) const
+  {
+    ByteBufferRead::require(rpos, len, size);
+  }
+};
+
+inline void schema_check_value(float value)
+{
+  ByteBufferRead::finite(value);
+}
+
+inline void schema_check_value(double value)
+{
+  ByteBufferRead::finite(value);
+}
+
+template<typename T>
+inline void schema_check_value(T) { }
+
+/// Wire format of one member value: arithmetic or enum stored as is (endian converted).
+template<typename T>
+struct SchemaValue
+{
+  static_assert((std::is_arithmetic<T>::value || std::is_enum<T>::value) && !std::is_same<T, bool>::value,
+    "SCHEMA_FIELD needs an arithmetic (not bool), enum or std::string member");
+
+  static bool const is_fixed = true;
+  static constexpr size_t fixed_size() { return sizeof(T); }
+  static size_t variable_size(T const&) { return 0; }
+
+  static uint8* write(uint8* cursor, T const& value)
+  {
+    return ByteBuffer::write_raw(cursor, value);
+  }
+
+  /// Unchecked, the run this field belongs to was checked by the caller.
+  static void read(SchemaReadCursor& cursor, T& member)
+  {
+    T value;
+    std::memcpy(&value, cursor.data + cursor.rpos, sizeof(T));
+    endian_convert(value);
+    schema_check_value(value);
+    member = value;
+    cursor.rpos += sizeof(T);
+  }
+};
+
+/// NUL terminated string, like operator<<(std::string).
+template<>
+struct SchemaValue<std::string>
+{
+  static bool const is_fixed = false;
+  static constexpr size_t fixed_size() { return 0; }
+  static size_t variable_size(std::string const& value) { return value.length() + 1; }
+
+  static uint8* write(uint8* cursor, std::string const& value)
+  {
+    if (size_t length = value.length())
+      std::memcpy(cursor, value.data(), length);
+    cursor[value.length()] = 0;
+    return cursor + value.length() + 1;
+  }
+
+  /// Like operator>>(std::string) a missing terminator takes the rest of the buffer.
+  static void read(SchemaReadCursor& cursor, std::string& member)
+  {
+    ByteBufferRead::cstring(cursor.data, cursor.size, cursor.rpos, member);
+  }
+};
+
+/// M is the declared member type, cv qualifiers included: const members can be written but
+/// not read.
+template<typename Class, typename M, M Class::*Member>
+struct SchemaField
+{
+  typedef typename std::remove_cv<M>::type T;
+
+  static bool const is_fixed = SchemaValue<T>::is_fixed;
+  static constexpr size_t fixed_size() { return SchemaValue<T>::fixed_size(); }
+  static size_t variable_size(Class const& object) { return SchemaValue<T>::variable_size(object.*Member); }
+
+  static uint8* write(uint8* cursor, Class const& object)
+  {
+    return SchemaValue<T>::write(cursor, object.*Member);
+  }
+
+  static void read(SchemaReadCursor& cursor, Class& object)
+  {
+    static_assert(!std::is_const<M>::value, "schema_read cannot assign a const member, drop the const or only schema_write the struct");
+    SchemaValue<T>::read(cursor, const_cast<T&>(object.*Member));
+  }
+};
+
+/// uint64 in the mask + non-zero bytes format of append_packed_uint64.
+template<typename Class, typename M, M Class::*Member>
+struct SchemaPackedUint64
+{
+  static_assert(std::is_same<typename std::remove_cv<M>::type, uint64>::value,
+    "SCHEMA_PACKED_UINT64 needs a uint64 member");
+
+  static bool const is_fixed = false;
+  static constexpr size_t fixed_size() { return 0; }
+
+  static size_t variable_size(Class const& object)
+  {
+    size_t size = 1;
+    for (uint64 value = object.*Member; value != 0; value >>= 8)
+      if (value & 0xFF)
+        ++size;
+    return size;
+  }
+
+  static uint8* write(uint8* cursor, Class const& object)
+  {
+    uint8 packed[8];
+    size_t packed_size = ByteBuffer::pack_uint64(object.*Member, cursor, packed);
+    if (packed_size)
+      std::memcpy(cursor + 1, packed, packed_size);
+    return cursor + 1 + packed_size;
+  }
+
+  static void read(SchemaReadCursor& cursor, Class& object)
+  {
+    static_assert(!std::is_const<M>::value, "schema_read cannot assign a const member, drop the const or only schema_write the struct");
+    uint8 mask = ByteBufferRead::value<uint8>(cursor.data, cursor.size, cursor.rpos);
+    ++cursor.rpos;
+    uint64 value = 0;
+    ByteBufferRead::packed_uint64(cursor.data, cursor.size, cursor.rpos, mask, value);
+    object.*Member = value;
+  }
+};
+
+/// Bytes of the run of fixed size fields starting at the first field.
+template<typename... Fields>
+struct SchemaRun
+{
+  static constexpr size_t size() { return 0; }
+};
+
+template<typename Field, typename... Rest>
+struct SchemaRun<Field, Rest...>
+{
+  static constexpr size_t size() { return Field::is_fixed ? Field::fixed_size() + SchemaRun<Rest...>::size() : 0; }
+};
+
+/// Checked tells whether the previous field was fixed, its run check then covers this one.
+template<bool Checked, typename... Fields>
+struct SchemaReader
+{
+  template<typename Class>
+  static void read(SchemaReadCursor&, Class&) { }
+};
+
+template<bool Checked, typename Field, typename... Rest>
+struct SchemaReader<Checked, Field, Rest...>
+{
+  template<typename Class>
+  static void read(SchemaReadCursor& cursor, Class& object)
+  {
+    if (Field::is_fixed && !Checked)
+      cursor.require(SchemaRun<Field, Rest...>::size());
+    Field::read(cursor, object);
+    SchemaReader<Field::is_fixed, Rest...>::read(cursor, object);
+  }
+};
+
+inline constexpr size_t schema_sum() { return 0; }
+
+template<typename... Sizes>
+inline constexpr size_t schema_sum(size_t first, Sizes... rest) { return first + schema_sum(rest...); }
+
+template<typename... Fields>
+struct SchemaFields
+{
+  /// Bytes taken by the fixed size fields, known at compile time.
+  static constexpr size_t fixed_size() { return schema_sum(Fields::fixed_size()...); }
+
+  template<typename Class>
+  static size_t size(Class const& object)
+  {
+    size_t total = fixed_size();
+    int expand[] = { 0, (total += Fields::variable_size(object), 0)... };
+    (void)expand;
+    return total;
+  }
+
+  template<typename Class>
+  static void write(ByteBuffer& buffer, Class const& object)
+  {
+    uint8* cursor = buffer.reserve_append(size(object));
+    int expand[] = { 0, (cursor = Fields::write(cursor, object), 0)... };
+    (void)expand;
+  }
+
+  template<typename Class>
+  static void read(ByteBuffer& buffer, Class& object)
+  {
+    buffer.reset_bitpos();
+    SchemaReadCursor cursor = { buffer.empty() ? nullptr : buffer.contents(), buffer.size(), buffer.rpos() };
+    SchemaReader<false, Fields...>::read(cursor, object);
+    buffer.rpos(cursor.rpos);
+  }
+
+  template<typename Class>
+  static void read(ByteBufferReader& reader, Class& object)
+  {
+    SchemaReadCursor cursor = { reader.data(), reader.size(), reader.rpos() };
+    SchemaReader<false, Fields...>::read(cursor, object);
+    reader.read_skip(cursor.rpos - reader.rpos());
+  }
+};
+
+template<typename T>
+inline void schema_write(ByteBuffer& buffer, T const& object)
+{
+  ByteBufferSchema<T>::write(buffer, object);
+}
+
+/// Throws ByteBufferPositionException when the buffer ends early, like the stream operators.
+template<typename T>
+inline void schema_read(ByteBuffer& buffer, T& object)
+{
+  ByteBufferSchema<T>::read(buffer, object);
+}
+
+/// Same over borrowed memory, e.g. a frame still in the socket read buffer.
+template<typename T>
+inline void schema_read(ByteBufferReader& reader, T& object)
+{
+  ByteBufferSchema<T>::read(reader, object);
+}
+
+template<typename T>
+inline size_t schema_size(T const& object)
+{
+  return ByteBufferSchema<T>::size(object);
+}
+
+#endif //__byte_buffer_schema_h__
@@ -0,0 +1,275 @@
+#ifndef __byte_buffer_view_h__
+#define __byte_buffer_view_h__
+#include "byte_buffer.h"
+#include "message_buffer.h"
+#include <string>
+
+/**
+  * @name   ByteBufferView
+  * @brief  Non-owning, read only ByteBuffer over bytes that stay where they are, typically a
+  *         frame in the socket read buffer or the active part of a MessageBuffer. It has the
+  *         checked read API of ByteBuffer (operator>>, read<T>, bits, packed guids), both over
+  *         ByteBufferRead, so packet handlers parse in place instead of going through
+  *         ByteBuffer(MessageBuffer&&), which takes the socket's storage and makes it allocate
+  *         a new read buffer. The bytes must outlive the view. ByteBufferReader is the
+  *         unchecked variant.
+*/
+class ByteBufferView
+{
+public:
+  ByteBufferView() : data_(nullptr), size_(0), rpos_(0), bitpos_(ByteBuffer::InitialBitPos), curbitval_(0) { }
+
+  ByteBufferView(uint8 const* data, size_t size) : data_(data), size_(size), rpos_(0),
+    bitpos_(ByteBuffer::InitialBitPos), curbitval_(0) { }
+
+  /// Views the unread bytes of buffer.
+  explicit ByteBufferView(MessageBuffer const& buffer) : data_(buffer.get_read_pointer()),
+    size_(buffer.get_active_size()), rpos_(0), bitpos_(ByteBuffer::InitialBitPos), curbitval_(0) { }
+
+  /// Views the unread bytes of buffer, from its rpos on, at rpos 0 like ByteBufferReader(ByteBuffer const&).
+  /// buffer's own rpos is left alone.
+  explicit ByteBufferView(ByteBuffer const& buffer) : data_(buffer.empty() ? nullptr : buffer.contents() + buffer.rpos()),
+    size_(buffer.size() - buffer.rpos()), rpos_(0), bitpos_(ByteBuffer::InitialBitPos), curbitval_(0) { }
+
+  void reset_bitpos()
+  {
+    if (bitpos_ > 7)
+      return;
+
+    bitpos_ = 8;
+    curbitval_ = 0;
+  }
+
+  bool read_bit()
+  {
+    ++bitpos_;
+    if (bitpos_ > 7)
+    {
+      curbitval_ = read<uint8>();
+      bitpos_ = 0;
+    }
+
+    return ((curbitval_ >> (7 - bitpos_)) & 1) != 0;
+  }
+
+  uint32 read_bits(int32 bits)
+  {
+    uint32 value = 0;
+    for (int32 i = bits - 1; i >= 0; --i)
+      if (read_bit())
+        value |= (1 << (i));
+
+    return value;
+  }
+
+  ByteBufferView &operator>>(bool &value)
+  {
+    value = read<char>() > 0 ? true : false;
+    return *this;
+  }
+
+  ByteBufferView &operator>>(uint8 &value)
+  {
+    value = read<uint8>();
+    return *this;
+  }
+
+  ByteBufferView &operator>>(uint16 &value)
+  {
+    value = read<uint16>();
+    return *this;
+  }
+
+  ByteBufferView &operator>>(uint32 &value)
+  {
+    value = read<uint32>();
+    return *this;
+  }
+
+  ByteBufferView &operator>>(uint64 &value)
+  {
+    value = read<uint64>();
+    return *this;
+  }
+
+  //signed as in 2e complement
+  ByteBufferView &operator>>(int8 &value)
+  {
+    value = read<int8>();
+    return *this;
+  }
+
+  ByteBufferView &operator>>(int16 &value)
+  {
+    value = read<int16>();
+    return *this;
+  }
+
+  ByteBufferView &operator>>(int32 &value)
+  {
+    value = read<int32>();
+    return *this;
+  }
+
+  ByteBufferView &operator>>(int64 &value)
+  {
+    value = read<int64>();
+    return *this;
+  }
+
+  ByteBufferView &operator>>(float &value)
+  {
+    value = ByteBufferRead::finite(read<float>());
+    return *this;
+  }
+
+  ByteBufferView &operator>>(double &value)
+  {
+    value = ByteBufferRead::finite(read<double>());
+    return *this;
+  }
+
+  ByteBufferView &operator>>(std::string& value)
+  {
+    if (rpos_ < size_)
+      reset_bitpos();
+    ByteBufferRead::cstring(data_, size_, rpos_, value);
+    return *this;
+  }
+
+  uint8 const& operator[](size_t const pos) const
+  {
+    if (pos >= size_)
+      throw ByteBufferPositionException(pos, 1, size_);
+    return data_[pos];
+  }
+
+  size_t rpos() const { return rpos_; }
+
+  size_t rpos(size_t rpos)
+  {
+    rpos_ = rpos;
+    return rpos_;
+  }
+
+  void rfinish()
+  {
+    rpos_ = size_;
+  }
+
+  template<typename T>
+  void read_skip() { read_skip(sizeof(T)); }
+
+  void read_skip(size_t skip)
+  {
+    ByteBufferRead::skip(size_, rpos_, skip);
+    reset_bitpos();
+  }
+
+  template <typename T>
+  T read()
+  {
+    reset_bitpos();
+    T r = read<T>(rpos_);
+    rpos_ += sizeof(T);
+    return r;
+  }
+
+  template <typename T>
+  T read(size_t pos) const
+  {
+    return ByteBufferRead::value<T>(data_, size_, pos);
+  }
+
+  template<class T>
+  void read(T* dest, size_t count)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "read(T*, size_t) must be used with trivially copyable types");
+    return read(reinterpret_cast<uint8*>(dest), count * sizeof(T));
+  }
+
+  void read(uint8 *dest, size_t len)
+  {
+    ByteBufferRead::bytes(data_, size_, rpos_, dest, len);
+    reset_bitpos();
+  }
+
+  void read_packed_uint64(uint64& guid)
+  {
+    guid = 0;
+    read_packed_uint64(read<uint8>(), guid);
+  }
+
+  void read_packed_uint64(uint8 mask, uint64& value)
+  {
+    ByteBufferRead::packed_uint64(data_, size_, rpos_, mask, value);
+    reset_bitpos();
+  }
+
+  std::string read_string(uint32 length)
+  {
+    std::string str = ByteBufferRead::string(data_, size_, rpos_, length);
+    reset_bitpos();
+    return str;
+  }
+
+  uint32 read_packed_time() { return ByteBuffer::unpack_time(read<uint32>()); }
+
+  uint8 const* contents() const
+  {
+    if (!size_)
+      throw ByteBufferException();
+    return data_;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  /// Copies the viewed bytes, for a packet that has to outlive the read buffer.
+  ByteBuffer to_byte_buffer() const
+  {
+    ByteBuffer buffer(size_);
+    if (size_)
+      buffer.append(data_, size_);
+    buffer.rpos(rpos_);
+    return buffer;
+  }
+
+private:
+  uint8 const* data_;
+  size_t size_;
+  size_t rpos_;
+  size_t bitpos_;
+  uint8 curbitval_;
+};
+
+template<> inline std::string ByteBufferView::read<std::string>()
+{
+  std::string tmp;
+  *this >> tmp;
+  return tmp;
+}
+
+template<>
+inline void ByteBufferView::read_skip<char*>()
+{
+  if (rpos_ >= size_)
+    return;
+
+  reset_bitpos();
+  ByteBufferRead::skip_cstring(data_, size_, rpos_);
+}
+
+template<>
+inline void ByteBufferView::read_skip<char const*>()
+{
+  read_skip<char*>();
+}
+
+template<>
+inline void ByteBufferView::read_skip<std::string>()
+{
+  read_skip<char*>();
+}
+
+#endif //__byte_buffer_view_h__
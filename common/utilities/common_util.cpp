@@ -1,4 +1,6 @@
 #include "common_util.h"
+#include <chrono>
+#include <cstring>
 
 
 Tokenizer::Tokenizer(const std::string& src, const char sep, uint32 vectorReserve /*= 0*/, bool keepEmptyStrings /*= true*/)
@@ -32,4 +34,10 @@ Tokenizer::Tokenizer(const std::string& src, const char sep, uint32 vectorReserv
 
     ++posnew;
   }
-}
\ No newline at end of file
+}
+
+uint64 get_steady_ms()
+{
+  return uint64(std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
@@ -33,4 +33,7 @@ private:
   StorageType storage_;
 };
 
+/// Milliseconds of a monotonic clock, for measuring intervals only.
+uint64 get_steady_ms();
+
 #endif //__common_util_h__
\ No newline at end of file
@@ -1,14 +1,16 @@
 #ifndef __message_buffer_h__
 #define __message_buffer_h__
 #include "define.h"
+#include "slab_pool.h"
 #include <vector>
 #include <cstring>
 
 class MessageBuffer
 {
-  typedef std::vector<uint8>::size_type size_type;
-
 public:
+  typedef SlabByteVector StorageType;
+  typedef StorageType::size_type size_type;
+
   MessageBuffer() : wpos_(0), rpos_(0), storage_()
   {
     storage_.resize(1024);
@@ -36,10 +38,28 @@ public:
     storage_.resize(bytes);
   }
 
+  /// Reallocates to a smaller storage (giving the memory back), keeping the active bytes.
+  void shrink_to(size_type bytes)
+  {
+    if (bytes >= storage_.size() || bytes < get_active_size())
+      return;
+
+    StorageType storage(bytes);
+    if (size_type active = get_active_size())
+      memcpy(storage.data(), get_read_pointer(), active);
+    wpos_ = get_active_size();
+    rpos_ = 0;
+    storage_.swap(storage);
+  }
+
   uint8* get_base_pointer() { return storage_.data(); }
 
+  uint8 const* get_base_pointer() const { return storage_.data(); }
+
   uint8* get_read_pointer() { return get_base_pointer() + rpos_; }
 
+  uint8 const* get_read_pointer() const { return get_base_pointer() + rpos_; }
+
   uint8* get_write_pointer() { return get_base_pointer() + wpos_; }
 
   void read_completed(size_type bytes) { rpos_ += bytes; }
@@ -66,7 +86,7 @@ public:
   void ensure_free_space()
   {
     if (get_remaining_space() == 0)
-      storage_.resize(storage_.size() * 3 / 2);
+      storage_.resize(SlabPool::round_size(storage_.size() * 3 / 2));
   }
 
   void write(void const* data, std::size_t size)
@@ -78,7 +98,7 @@ public:
     }
   }
 
-  std::vector<uint8>&& move()
+  StorageType&& move()
   {
     wpos_ = 0;
     rpos_ = 0;
@@ -112,7 +132,7 @@ public:
 private:
   size_type wpos_;
   size_type rpos_;
-  std::vector<uint8> storage_;
+  StorageType storage_;
 };
 
 #endif /* __message_buffer_h__ */
@@ -0,0 +1,82 @@
+#ifndef __mpsc_queue_h__
+#define __mpsc_queue_h__
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+  * @name   MPSCQueue
+  * @brief  Lock-free multi-producer single-consumer queue (D. Vyukov's intrusive node queue).
+  *         enqueue() may be called from any thread, dequeue() only from the owning consumer.
+  *         A dequeue racing with an unfinished enqueue may report empty; the element
+  *         becomes visible on a later dequeue.
+*/
+template<typename T>
+class MPSCQueue
+{
+public:
+  MPSCQueue() : head_(new Node()), tail_(head_.load(std::memory_order_relaxed))
+  {
+  }
+
+  ~MPSCQueue()
+  {
+    Node* node = tail_->next.load(std::memory_order_relaxed);
+    delete tail_;
+    while (node)
+    {
+      Node* next = node->next.load(std::memory_order_relaxed);
+      node->value()->~T();
+      delete node;
+      node = next;
+    }
+  }
+
+  MPSCQueue(MPSCQueue const&) = delete;
+  MPSCQueue& operator=(MPSCQueue const&) = delete;
+
+  void enqueue(T&& input)
+  {
+    Node* node = new Node();
+    new (node->value()) T(std::move(input));
+    Node* prev_head = head_.exchange(node, std::memory_order_acq_rel);
+    prev_head->next.store(node, std::memory_order_release);
+  }
+
+  bool dequeue(T& result)
+  {
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (!next)
+      return false;
+
+    // next becomes the new stub node, its value is moved out and destroyed here
+    result = std::move(*next->value());
+    next->value()->~T();
+    tail_ = next;
+    delete tail;
+    return true;
+  }
+
+  bool empty() const
+  {
+    return tail_->next.load(std::memory_order_acquire) == nullptr;
+  }
+
+private:
+  struct Node
+  {
+    Node() : next(nullptr) { }
+
+    T* value() { return reinterpret_cast<T*>(&storage); }
+
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    std::atomic<Node*> next;
+  };
+
+  std::atomic<Node*> head_;
+  Node* tail_;
+};
+
+#endif /* __mpsc_queue_h__ */
@@ -0,0 +1,240 @@
+#include "ring_message_buffer.h"
+#include <cstring>
+#include <new>
+#include <utility>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  std::size_t page_size()
+  {
+#ifdef __linux__
+    static std::size_t const size = std::size_t(sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+  }
+
+  std::size_t round_to_page(std::size_t size)
+  {
+    std::size_t page = page_size();
+    return (size + page - 1) / page * page;
+  }
+
+#ifdef __linux__
+  uint8* map_mirrored(std::size_t capacity)
+  {
+    int fd = memfd_create("otter_ring_buffer", MFD_CLOEXEC);
+    if (fd < 0)
+      return nullptr;
+
+    uint8* base = nullptr;
+    if (ftruncate(fd, off_t(capacity)) == 0)
+    {
+      // reserve 2 * capacity of address space, then map the same file into both halves
+      void* area = mmap(nullptr, capacity * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (area != MAP_FAILED)
+      {
+        uint8* first = static_cast<uint8*>(area);
+        if (mmap(first, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED &&
+          mmap(first + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED)
+          base = first;
+        else
+          munmap(area, capacity * 2);
+      }
+    }
+
+    close(fd);
+    return base;
+  }
+#endif
+}
+
+RingMessageBuffer::RingMessageBuffer() : base_(nullptr), capacity_(0), wpos_(0), rpos_(0), mirrored_(false),
+  parked_base_(nullptr), parked_capacity_(0)
+{
+}
+
+RingMessageBuffer::RingMessageBuffer(size_type initial_size) : base_(nullptr), capacity_(0),
+  wpos_(0), rpos_(0), mirrored_(false), parked_base_(nullptr), parked_capacity_(0)
+{
+  if (initial_size)
+    allocate(round_to_page(initial_size));
+}
+
+RingMessageBuffer::~RingMessageBuffer()
+{
+  release();
+}
+
+RingMessageBuffer::RingMessageBuffer(RingMessageBuffer&& right) noexcept : base_(right.base_),
+  capacity_(right.capacity_), wpos_(right.wpos_), rpos_(right.rpos_), mirrored_(right.mirrored_),
+  parked_base_(right.parked_base_), parked_capacity_(right.parked_capacity_)
+{
+  right.base_ = nullptr;
+  right.capacity_ = 0;
+  right.mirrored_ = false;
+  right.parked_base_ = nullptr;
+  right.parked_capacity_ = 0;
+  right.reset();
+}
+
+RingMessageBuffer& RingMessageBuffer::operator=(RingMessageBuffer&& right) noexcept
+{
+  if (this != &right)
+  {
+    release();
+    std::swap(base_, right.base_);
+    std::swap(capacity_, right.capacity_);
+    std::swap(wpos_, right.wpos_);
+    std::swap(rpos_, right.rpos_);
+    std::swap(mirrored_, right.mirrored_);
+    std::swap(parked_base_, right.parked_base_);
+    std::swap(parked_capacity_, right.parked_capacity_);
+  }
+
+  return *this;
+}
+
+void RingMessageBuffer::allocate(size_type capacity)
+{
+#ifdef __linux__
+  if (parked_base_)
+  {
+    // the pages were freed by park(), the larger parked capacity costs nothing until written
+    if (parked_capacity_ >= capacity)
+    {
+      base_ = parked_base_;
+      capacity_ = parked_capacity_;
+      mirrored_ = true;
+      parked_base_ = nullptr;
+      parked_capacity_ = 0;
+      return;
+    }
+
+    munmap(parked_base_, parked_capacity_ * 2);
+    parked_base_ = nullptr;
+    parked_capacity_ = 0;
+  }
+
+  if (uint8* base = map_mirrored(capacity))
+  {
+    base_ = base;
+    capacity_ = capacity;
+    mirrored_ = true;
+    return;
+  }
+#endif
+
+  base_ = static_cast<uint8*>(::operator new(capacity));
+  capacity_ = capacity;
+  mirrored_ = false;
+}
+
+void RingMessageBuffer::release()
+{
+#ifdef __linux__
+  if (parked_base_)
+  {
+    munmap(parked_base_, parked_capacity_ * 2);
+    parked_base_ = nullptr;
+    parked_capacity_ = 0;
+  }
+#endif
+
+  if (!base_)
+    return;
+
+#ifdef __linux__
+  if (mirrored_)
+    munmap(base_, capacity_ * 2);
+  else
+#endif
+    ::operator delete(base_);
+
+  base_ = nullptr;
+  capacity_ = 0;
+  mirrored_ = false;
+}
+
+/// Empty buffer: frees the pages but keeps a mirrored mapping for the next allocate().
+void RingMessageBuffer::park()
+{
+#ifdef __linux__
+  // the pages belong to the memfd, MADV_DONTNEED would only drop this mapping's view of them
+  if (mirrored_ && madvise(base_, capacity_, MADV_REMOVE) == 0)
+  {
+    parked_base_ = base_;
+    parked_capacity_ = capacity_;
+    base_ = nullptr;
+    capacity_ = 0;
+    mirrored_ = false;
+    return;
+  }
+#endif
+
+  release();
+}
+
+void RingMessageBuffer::resize(size_type bytes)
+{
+  size_type active = get_active_size();
+  size_type capacity = round_to_page(bytes > active ? bytes : active);
+  if (capacity == capacity_)
+    return;
+
+  if (!capacity)
+  {
+    park();
+    reset();
+    return;
+  }
+
+  if (!base_)
+  {
+    reset();
+    allocate(capacity);
+    return;
+  }
+
+  RingMessageBuffer resized(capacity);
+  if (active)
+    memcpy(resized.base_, get_read_pointer(), active);
+  resized.wpos_ = active;
+  *this = std::move(resized);
+}
+
+void RingMessageBuffer::normalize()
+{
+  if (mirrored_)
+  {
+    // the second mapping aliases the first, folding the positions moves no data
+    if (rpos_ >= capacity_)
+    {
+      rpos_ -= capacity_;
+      wpos_ -= capacity_;
+    }
+    return;
+  }
+
+  if (rpos_)
+  {
+    if (rpos_ != wpos_)
+      memmove(base_, base_ + rpos_, get_active_size());
+    wpos_ -= rpos_;
+    rpos_ = 0;
+  }
+}
+
+void RingMessageBuffer::write(void const* data, std::size_t size)
+{
+  if (size)
+  {
+    memcpy(get_write_pointer(), data, size);
+    write_completed(size);
+  }
+}
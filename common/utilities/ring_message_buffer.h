@@ -0,0 +1,100 @@
+#ifndef __ring_message_buffer_h__
+#define __ring_message_buffer_h__
+#include "define.h"
+#include <cstddef>
+
+/**
+  * @name   RingMessageBuffer
+  * @brief  MessageBuffer compatible ring buffer for socket reads. On Linux the storage is a
+  *         "magic ring": one memfd mapped twice back to back, so the active bytes and the free
+  *         space are always contiguous and normalize() only folds the positions instead of
+  *         moving data. Elsewhere (or if the mapping fails) it falls back to a linear buffer
+  *         that behaves like MessageBuffer. Capacity is rounded up to the page size; a buffer
+  *         of size 0 holds no mapping until the first resize() or ensure_free_space().
+  *
+  *         Each mirrored buffer costs two VMAs for as long as it lives, idle periods included:
+  *         resize(0) frees the pages (MADV_REMOVE) but keeps the mapping for the next grow, so
+  *         a socket that reads on readiness does not remap on every wakeup. With the default
+  *         vm.max_map_count (65530) that caps a process at about 32k ring buffers, raise it
+  *         or use MessageBuffer for large numbers of connections.
+*/
+class RingMessageBuffer
+{
+public:
+  typedef std::size_t size_type;
+
+  RingMessageBuffer();
+  explicit RingMessageBuffer(size_type initial_size);
+  ~RingMessageBuffer();
+
+  RingMessageBuffer(RingMessageBuffer const&) = delete;
+  RingMessageBuffer& operator=(RingMessageBuffer const&) = delete;
+  RingMessageBuffer(RingMessageBuffer&& right) noexcept;
+  RingMessageBuffer& operator=(RingMessageBuffer&& right) noexcept;
+
+  void reset()
+  {
+    wpos_ = 0;
+    rpos_ = 0;
+  }
+
+  /// Reallocates to at least bytes (never below the active size), keeping the active bytes.
+  /// 0 with nothing buffered frees the memory, a mirrored mapping is kept and reused by the
+  /// next resize() that fits in it.
+  void resize(size_type bytes);
+
+  void shrink_to(size_type bytes)
+  {
+    if (bytes < capacity_)
+      resize(bytes);
+  }
+
+  uint8* get_read_pointer() { return base_ + rpos_; }
+
+  uint8 const* get_read_pointer() const { return base_ + rpos_; }
+
+  uint8* get_write_pointer() { return base_ + wpos_; }
+
+  void read_completed(size_type bytes)
+  {
+    rpos_ += bytes;
+    if (mirrored_ && rpos_ >= capacity_)
+      normalize();
+  }
+
+  void write_completed(size_type bytes) { wpos_ += bytes; }
+
+  size_type get_active_size() const { return wpos_ - rpos_; }
+
+  size_type get_remaining_space() const { return (mirrored_ ? rpos_ + capacity_ : capacity_) - wpos_; }
+
+  size_type get_buffer_size() const { return capacity_; }
+
+  bool is_mirrored() const { return mirrored_; }
+
+  void normalize();
+
+  void ensure_free_space()
+  {
+    if (get_remaining_space() == 0)
+      resize(capacity_ ? capacity_ * 3 / 2 : 1);
+  }
+
+  void write(void const* data, std::size_t size);
+
+private:
+  void allocate(size_type capacity);
+  void release();
+  void park();
+
+  uint8* base_;
+  size_type capacity_;
+  size_type wpos_;
+  size_type rpos_;
+  bool mirrored_;
+  /// Mirrored mapping kept by park() while the buffer is empty, base_ is null meanwhile.
+  uint8* parked_base_;
+  size_type parked_capacity_;
+};
+
+#endif /* __ring_message_buffer_h__ */
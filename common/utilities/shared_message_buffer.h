@@ -0,0 +1,45 @@
+#ifndef __shared_message_buffer_h__
+#define __shared_message_buffer_h__
+#include "message_buffer.h"
+#include <memory>
+
+/**
+  * @name   SharedMessageBuffer
+  * @brief  Immutable, reference counted payload with a private read cursor. Build a packet once,
+  *         wrap it and queue the same SharedMessageBuffer on any number of sockets: copies share
+  *         the bytes and only the read offset is per copy, so partial writes stay per socket.
+*/
+class SharedMessageBuffer
+{
+public:
+  typedef MessageBuffer::size_type size_type;
+
+  SharedMessageBuffer() : rpos_(0) { }
+
+  explicit SharedMessageBuffer(MessageBuffer&& buffer) :
+    payload_(std::make_shared<MessageBuffer const>(std::move(buffer))), rpos_(0) { }
+
+  SharedMessageBuffer(void const* data, std::size_t size) : rpos_(0)
+  {
+    std::shared_ptr<MessageBuffer> payload = std::make_shared<MessageBuffer>(size);
+    payload->write(data, size);
+    payload_ = std::move(payload);
+  }
+
+  bool empty() const { return !payload_; }
+
+  uint8 const* get_read_pointer() const { return payload_->get_read_pointer() + rpos_; }
+
+  size_type get_active_size() const { return payload_ ? payload_->get_active_size() - rpos_ : 0; }
+
+  void read_completed(size_type bytes) { rpos_ += bytes; }
+
+  /// Number of SharedMessageBuffer copies still referencing the payload.
+  long use_count() const { return payload_.use_count(); }
+
+private:
+  std::shared_ptr<MessageBuffer const> payload_;
+  size_type rpos_;
+};
+
+#endif /* __shared_message_buffer_h__ */
@@ -0,0 +1,271 @@
+#include "slab_pool.h"
+#include <algorithm>
+#include <mutex>
+#include <new>
+
+namespace
+{
+  std::size_t const size_classes[SlabPool::SIZE_CLASS_COUNT] =
+  {
+    256, 1024, 4 * 1024, 16 * 1024, SlabPool::MAX_BLOCK_SIZE
+  };
+
+  struct PoolRegistry
+  {
+    std::mutex lock;
+    /// Every pool ever created, pools are never freed.
+    std::vector<SlabPool const*> pools;
+    /// Pools of exited threads, handed to the next new thread.
+    std::vector<SlabPool*> spare_pools;
+  };
+
+  /// Never destroyed, static constructors and destructors of other files allocate as well.
+  PoolRegistry& get_registry()
+  {
+    static PoolRegistry* registry = new PoolRegistry();
+    return *registry;
+  }
+
+  // trivially destructible, so they stay readable while thread_local destructors run
+  thread_local SlabPool* current_pool = nullptr;
+  thread_local bool current_pool_retired = false;
+
+  void add_stats(SlabPool::Stats& total, SlabPool::Stats const& stats)
+  {
+    total.hits += stats.hits;
+    total.misses += stats.misses;
+    total.outstanding_bytes += stats.outstanding_bytes;
+    total.cached_bytes += stats.cached_bytes;
+    total.remote_frees += stats.remote_frees;
+  }
+}
+
+/// Retires the pool of a thread when its thread_local objects are destroyed.
+struct SlabPoolRetirer
+{
+  ~SlabPoolRetirer()
+  {
+    current_pool_retired = true;
+    if (SlabPool* pool = current_pool)
+    {
+      current_pool = nullptr;
+      pool->retire();
+    }
+  }
+};
+
+SlabPool* SlabPool::instance()
+{
+  if (!current_pool && !current_pool_retired)
+  {
+    static thread_local SlabPoolRetirer retirer;
+    (void)retirer;
+    current_pool = acquire();
+  }
+
+  return current_pool;
+}
+
+SlabPool* SlabPool::acquire()
+{
+  PoolRegistry& registry = get_registry();
+  std::lock_guard<std::mutex> lock(registry.lock);
+  if (!registry.spare_pools.empty())
+  {
+    SlabPool* pool = registry.spare_pools.back();
+    registry.spare_pools.pop_back();
+    pool->retired_.store(false, std::memory_order_release);
+    return pool;
+  }
+
+  SlabPool* pool = new SlabPool();
+  registry.pools.push_back(pool);
+  return pool;
+}
+
+SlabPool::Stats SlabPool::get_global_stats()
+{
+  PoolRegistry& registry = get_registry();
+  std::lock_guard<std::mutex> lock(registry.lock);
+  Stats total;
+  for (SlabPool const* pool : registry.pools)
+    add_stats(total, pool->get_stats());
+  return total;
+}
+
+std::size_t SlabPool::round_size(std::size_t size)
+{
+  int32 index = size_class(size);
+  return index < 0 ? size : size_classes[index];
+}
+
+int32 SlabPool::size_class(std::size_t size)
+{
+  for (uint32 i = 0; i < SIZE_CLASS_COUNT; ++i)
+    if (size <= size_classes[i])
+      return int32(i);
+  return -1;
+}
+
+SlabPool::SlabPool() : remote_frees_(nullptr), retired_(false), hits_(0), misses_(0),
+  outstanding_bytes_(0), cached_bytes_(0), remote_free_count_(0)
+{
+  static_assert(sizeof(BlockHeader) <= HEADER_SIZE, "SlabPool block header does not fit HEADER_SIZE");
+  static_assert(sizeof(FreeBlock) <= HEADER_SIZE + 256, "SlabPool free block link does not fit the smallest block");
+  std::fill(std::begin(free_lists_), std::end(free_lists_), nullptr);
+  std::fill(std::begin(free_counts_), std::end(free_counts_), 0);
+}
+
+void SlabPool::retire()
+{
+  // from here on other threads release our blocks to the heap
+  retired_.store(true, std::memory_order_release);
+  drain_remote();
+
+  for (uint32 i = 0; i < SIZE_CLASS_COUNT; ++i)
+  {
+    while (FreeBlock* block = free_lists_[i])
+    {
+      free_lists_[i] = block->next;
+      ::operator delete(block);
+    }
+
+    free_counts_[i] = 0;
+  }
+
+  cached_bytes_ = 0;
+  // a release racing with the flag may still land in remote_frees_, the next owner drains it
+  PoolRegistry& registry = get_registry();
+  std::lock_guard<std::mutex> lock(registry.lock);
+  registry.spare_pools.push_back(this);
+}
+
+void* SlabPool::allocate(std::size_t size)
+{
+  int32 index = size_class(size);
+  SlabPool* pool = instance();
+  if (index < 0)
+  {
+    if (pool)
+    {
+      bump(pool->misses_, uint64(1));
+      bump(pool->outstanding_bytes_, int64(size));
+    }
+
+    return ::operator new(size);
+  }
+
+  if (pool)
+    return pool->allocate_block(index);
+
+  // thread teardown, the block has no owner and goes back to the heap
+  FreeBlock* block = static_cast<FreeBlock*>(::operator new(HEADER_SIZE + size_classes[index]));
+  block->header.owner = nullptr;
+  block->header.size_class = uint32(index);
+  return reinterpret_cast<uint8*>(block) + HEADER_SIZE;
+}
+
+void* SlabPool::allocate_block(int32 index)
+{
+  std::size_t block_size = size_classes[index];
+  bump(outstanding_bytes_, int64(block_size));
+  if (!free_lists_[index] && remote_frees_.load(std::memory_order_relaxed))
+    drain_remote();
+
+  FreeBlock* block = free_lists_[index];
+  if (block)
+  {
+    free_lists_[index] = block->next;
+    --free_counts_[index];
+    bump(hits_, uint64(1));
+    bump(cached_bytes_, uint64(0) - block_size);
+  }
+  else
+  {
+    bump(misses_, uint64(1));
+    block = static_cast<FreeBlock*>(::operator new(HEADER_SIZE + block_size));
+    block->header.owner = this;
+    block->header.size_class = uint32(index);
+  }
+
+  return reinterpret_cast<uint8*>(block) + HEADER_SIZE;
+}
+
+void SlabPool::deallocate(void* ptr, std::size_t size)
+{
+  if (!ptr)
+    return;
+
+  if (size_class(size) < 0)
+  {
+    if (SlabPool* pool = current_pool)
+      bump(pool->outstanding_bytes_, -int64(size));
+    ::operator delete(ptr);
+    return;
+  }
+
+  FreeBlock* block = reinterpret_cast<FreeBlock*>(static_cast<uint8*>(ptr) - HEADER_SIZE);
+  SlabPool* owner = block->header.owner;
+  if (!owner)
+    ::operator delete(block);
+  else if (owner == current_pool)
+    owner->release_local(block);
+  else
+    owner->release_remote(block);
+}
+
+void SlabPool::release_local(FreeBlock* block)
+{
+  std::size_t block_size = size_classes[block->header.size_class];
+  bump(outstanding_bytes_, -int64(block_size));
+  uint32& count = free_counts_[block->header.size_class];
+  if (count * block_size >= MAX_CACHED_BYTES)
+  {
+    ::operator delete(block);
+    return;
+  }
+
+  FreeBlock*& head = free_lists_[block->header.size_class];
+  block->next = head;
+  head = block;
+  ++count;
+  bump(cached_bytes_, uint64(block_size));
+}
+
+void SlabPool::release_remote(FreeBlock* block)
+{
+  // nobody drains a retired pool until a new thread takes it over
+  if (retired_.load(std::memory_order_acquire))
+  {
+    ::operator delete(block);
+    return;
+  }
+
+  FreeBlock* head = remote_frees_.load(std::memory_order_relaxed);
+  do
+    block->next = head;
+  while (!remote_frees_.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void SlabPool::drain_remote()
+{
+  FreeBlock* block = remote_frees_.exchange(nullptr, std::memory_order_acquire);
+  while (block)
+  {
+    FreeBlock* next = block->next;
+    bump(remote_free_count_, uint64(1));
+    release_local(block);
+    block = next;
+  }
+}
+
+SlabPool::Stats SlabPool::get_stats() const
+{
+  Stats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.outstanding_bytes = outstanding_bytes_.load(std::memory_order_relaxed);
+  stats.cached_bytes = cached_bytes_.load(std::memory_order_relaxed);
+  stats.remote_frees = remote_free_count_.load(std::memory_order_relaxed);
+  return stats;
+}
@@ -0,0 +1,161 @@
+#ifndef __slab_pool_h__
+#define __slab_pool_h__
+#include "define.h"
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+  * @name   SlabPool
+  * @brief  Per-thread cache of fixed size blocks (256 B, 1 KiB, 4 KiB, 16 KiB, 64 KiB).
+  *         Requests are rounded up to the next size class and served from the calling
+  *         thread's free list; larger requests go straight to the heap. Every block carries
+  *         its owning pool in a small header: a block released on another thread goes back
+  *         to the owner through a lock-free remote free list, which the owner drains when it
+  *         allocates. Caches therefore only hold blocks their own thread allocated (and
+  *         touched first, so they stay on that thread's NUMA node).
+  *
+  *         Pools are never destroyed. When a thread exits its pool releases its cache and is
+  *         kept for the next new thread, frees into it meanwhile go to the heap. Blocks
+  *         allocated or released after the calling thread's pool was retired (thread_local
+  *         and static destructors) bypass the pool.
+*/
+class SlabPool
+{
+public:
+  static uint32 const SIZE_CLASS_COUNT = 5;
+  static std::size_t const MAX_BLOCK_SIZE = 64 * 1024;
+  /// Upper bound of cached (free) bytes per size class and thread.
+  static std::size_t const MAX_CACHED_BYTES = 4 * 1024 * 1024;
+
+  struct Stats
+  {
+    Stats() : hits(0), misses(0), outstanding_bytes(0), cached_bytes(0), remote_frees(0) { }
+
+    double hit_rate() const { return hits + misses ? double(hits) / double(hits + misses) : 0.0; }
+
+    uint64 hits;
+    uint64 misses;
+    /// Allocated minus released. Size class blocks count on their owner, blocks above
+    /// MAX_BLOCK_SIZE on the thread that handles them, so this may be negative per thread.
+    int64 outstanding_bytes;
+    uint64 cached_bytes;
+    /// Blocks released on another thread and returned through the remote free list.
+    uint64 remote_frees;
+  };
+
+  /// Pool of the calling thread, nullptr once it was retired during thread exit.
+  static SlabPool* instance();
+
+  /// Sum over all pools, including the ones of threads that already exited.
+  static Stats get_global_stats();
+
+  /// Size actually handed out for a request of size bytes.
+  static std::size_t round_size(std::size_t size);
+
+  /// Thread-safe, ptr may be released on any thread with the size it was allocated with.
+  static void* allocate(std::size_t size);
+  static void deallocate(void* ptr, std::size_t size);
+
+  Stats get_stats() const;
+
+  SlabPool(SlabPool const&) = delete;
+  SlabPool& operator=(SlabPool const&) = delete;
+
+private:
+  friend struct SlabPoolRetirer;
+
+  /// Bytes in front of every size class block, keeps the block max_align_t aligned.
+  static std::size_t const HEADER_SIZE = 16;
+
+  struct BlockHeader
+  {
+    SlabPool* owner;
+    uint32 size_class;
+  };
+
+  /// A free block, linked through the first bytes after its header.
+  struct FreeBlock
+  {
+    BlockHeader header;
+    FreeBlock* next;
+  };
+
+  SlabPool();
+  ~SlabPool() = delete;
+
+  static int32 size_class(std::size_t size);
+  static SlabPool* acquire();
+
+  void* allocate_block(int32 index);
+  void release_local(FreeBlock* block);
+  void release_remote(FreeBlock* block);
+  /// Moves the blocks other threads returned into the local free lists.
+  void drain_remote();
+  /// Thread exit: frees the cache and parks the pool for reuse.
+  void retire();
+
+  template<typename V>
+  static void bump(std::atomic<V>& counter, V value)
+  {
+    // single writer, readers only sample for stats
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+  FreeBlock* free_lists_[SIZE_CLASS_COUNT];
+  uint32 free_counts_[SIZE_CLASS_COUNT];
+  std::atomic<FreeBlock*> remote_frees_;
+  std::atomic<bool> retired_;
+  std::atomic<uint64> hits_;
+  std::atomic<uint64> misses_;
+  std::atomic<int64> outstanding_bytes_;
+  std::atomic<uint64> cached_bytes_;
+  std::atomic<uint64> remote_free_count_;
+};
+
+template<typename T>
+class SlabAllocator
+{
+public:
+  typedef T value_type;
+
+  SlabAllocator() noexcept { }
+  template<typename U>
+  SlabAllocator(SlabAllocator<U> const&) noexcept { }
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(SlabPool::allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, std::size_t n)
+  {
+    SlabPool::deallocate(ptr, n * sizeof(T));
+  }
+
+  /// resize() default-initializes: buffers are written before they are read, so grown
+  /// bytes are not zeroed first. Explicit values (resize(n, 0)) still are.
+  template<typename U>
+  void construct(U* ptr) noexcept(std::is_nothrow_default_constructible<U>::value)
+  {
+    ::new(static_cast<void*>(ptr)) U;
+  }
+
+  template<typename U, typename... Args>
+  void construct(U* ptr, Args&&... args)
+  {
+    ::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+
+  template<typename U>
+  bool operator==(SlabAllocator<U> const&) const noexcept { return true; }
+  template<typename U>
+  bool operator!=(SlabAllocator<U> const&) const noexcept { return false; }
+};
+
+typedef std::vector<uint8, SlabAllocator<uint8>> SlabByteVector;
+
+#endif /* __slab_pool_h__ */
@@ -0,0 +1,187 @@
+#include "task_pool.h"
+#include "errors.h"
+#include "log.h"
+#include <exception>
+
+namespace
+{
+  thread_local TaskPool* current_pool = nullptr;
+  thread_local uint32 current_worker = 0;
+  thread_local TaskStrand const* current_strand = nullptr;
+}
+
+void TaskStrand::post(Task&& task)
+{
+  tasks_.enqueue(std::move(task));
+  if (!scheduled_.exchange(true, std::memory_order_acq_rel))
+    pool_.schedule(shared_from_this());
+}
+
+void TaskStrand::dispatch(Task&& task)
+{
+  if (running_in_this_thread())
+    task();
+  else
+    post(std::move(task));
+}
+
+bool TaskStrand::running_in_this_thread() const
+{
+  return current_strand == this;
+}
+
+bool TaskStrand::run(uint32 max_tasks)
+{
+  Task task;
+  for (uint32 i = 0; i < max_tasks && tasks_.dequeue(task); ++i)
+  {
+    try
+    {
+      task();
+    }
+    catch (std::exception const& err)
+    {
+      LOG_ERROR("network", "TaskStrand::run: task threw: {}", err.what());
+    }
+
+    task = nullptr;
+  }
+
+  if (!tasks_.empty())
+    return true;
+
+  // a post racing with this either sees scheduled_ cleared and schedules the strand itself,
+  // or its task is visible to the empty() check below
+  scheduled_.exchange(false, std::memory_order_acq_rel);
+  return !tasks_.empty() && !scheduled_.exchange(true, std::memory_order_acq_rel);
+}
+
+TaskPool::TaskPool(uint32 worker_count, uint32 batch_size) : batch_size_(batch_size ? batch_size : 1),
+  stopped_(false), next_worker_(0), pending_(0), idle_workers_(0), steals_(0)
+{
+  ASSERT(worker_count > 0);
+  for (uint32 i = 0; i < worker_count; ++i)
+    workers_.push_back(new Worker());
+}
+
+TaskPool::~TaskPool()
+{
+  stop();
+  wait();
+  for (Worker* worker : workers_)
+    delete worker;
+}
+
+bool TaskPool::start()
+{
+  if (workers_[0]->thread)
+    return false;
+
+  for (uint32 i = 0; i < workers_.size(); ++i)
+    workers_[i]->thread = new std::thread(&TaskPool::run, this, i);
+  return true;
+}
+
+void TaskPool::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleep_lock_);
+    stopped_ = true;
+  }
+  wake_.notify_all();
+}
+
+void TaskPool::wait()
+{
+  for (Worker* worker : workers_)
+  {
+    if (!worker->thread)
+      continue;
+
+    worker->thread->join();
+    delete worker->thread;
+    worker->thread = nullptr;
+  }
+}
+
+std::shared_ptr<TaskStrand> TaskPool::make_strand()
+{
+  return std::make_shared<TaskStrand>(*this);
+}
+
+void TaskPool::schedule(std::shared_ptr<TaskStrand>&& strand)
+{
+  // workers keep what they schedule, other threads spread strands round robin
+  uint32 index = current_pool == this ? current_worker :
+    next_worker_.fetch_add(1, std::memory_order_relaxed) % uint32(workers_.size());
+  Worker* worker = workers_[index];
+  {
+    std::lock_guard<std::mutex> lock(worker->lock);
+    worker->strands.push_back(std::move(strand));
+  }
+
+  ++pending_;
+  if (idle_workers_)
+  {
+    std::lock_guard<std::mutex> lock(sleep_lock_);
+    wake_.notify_one();
+  }
+}
+
+std::shared_ptr<TaskStrand> TaskPool::take(uint32 index)
+{
+  std::shared_ptr<TaskStrand> strand;
+  uint32 count = uint32(workers_.size());
+  for (uint32 i = 0; i < count && !strand; ++i)
+  {
+    Worker* worker = workers_[(index + i) % count];
+    std::lock_guard<std::mutex> lock(worker->lock);
+    if (worker->strands.empty())
+      continue;
+
+    // own queue in order, thieves take from the back
+    if (i == 0)
+    {
+      strand = std::move(worker->strands.front());
+      worker->strands.pop_front();
+    }
+    else
+    {
+      strand = std::move(worker->strands.back());
+      worker->strands.pop_back();
+      ++steals_;
+    }
+  }
+
+  if (strand)
+    --pending_;
+  return strand;
+}
+
+void TaskPool::run(uint32 index)
+{
+  current_pool = this;
+  current_worker = index;
+  while (!stopped_)
+  {
+    std::shared_ptr<TaskStrand> strand = take(index);
+    if (!strand)
+    {
+      ++idle_workers_;
+      {
+        std::unique_lock<std::mutex> lock(sleep_lock_);
+        wake_.wait(lock, [this]() { return pending_ > 0 || stopped_; });
+      }
+      --idle_workers_;
+      continue;
+    }
+
+    current_strand = strand.get();
+    bool again = strand->run(batch_size_);
+    current_strand = nullptr;
+    if (again)
+      schedule(std::move(strand));
+  }
+
+  current_pool = nullptr;
+}
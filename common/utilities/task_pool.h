@@ -0,0 +1,109 @@
+#ifndef __task_pool_h__
+#define __task_pool_h__
+#include "define.h"
+#include "mpsc_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Tasks a strand runs before it goes back to the queues, so long queues do not starve others.
+#define TASK_POOL_BATCH_SIZE 64
+
+class TaskPool;
+
+/**
+  * @name   TaskStrand
+  * @brief  Serial task queue of one connection. As with common::asio::Strand its tasks never
+  *         run concurrently and run in posting order, on whichever TaskPool worker picked the
+  *         strand up. The whole strand is what workers schedule and steal.
+*/
+class TaskStrand : public std::enable_shared_from_this<TaskStrand>
+{
+public:
+  typedef std::function<void()> Task;
+
+  explicit TaskStrand(TaskPool& pool) : pool_(pool), scheduled_(false) { }
+
+  TaskStrand(TaskStrand const&) = delete;
+  TaskStrand& operator=(TaskStrand const&) = delete;
+
+  /// Thread-safe.
+  void post(Task&& task);
+
+  /// Runs the task right away when called from a task of this strand, posts it otherwise.
+  void dispatch(Task&& task);
+
+  bool running_in_this_thread() const;
+
+private:
+  friend class TaskPool;
+
+  /// Runs up to max_tasks, returns true when the strand has to be scheduled again.
+  bool run(uint32 max_tasks);
+
+  TaskPool& pool_;
+  MPSCQueue<Task> tasks_;
+  std::atomic<bool> scheduled_;
+};
+
+/**
+  * @name   TaskPool
+  * @brief  Work-stealing workers for packet handling off the network threads. Each worker
+  *         owns a queue of scheduled strands; a worker without work steals a whole strand
+  *         from another one, so one slow connection only delays its own tasks.
+*/
+class TaskPool
+{
+public:
+  explicit TaskPool(uint32 worker_count, uint32 batch_size = TASK_POOL_BATCH_SIZE);
+  ~TaskPool();
+
+  TaskPool(TaskPool const&) = delete;
+  TaskPool& operator=(TaskPool const&) = delete;
+
+  bool start();
+
+  /// Workers exit after their current task, tasks still queued are dropped.
+  void stop();
+  void wait();
+
+  std::shared_ptr<TaskStrand> make_strand();
+
+  uint32 get_worker_count() const { return uint32(workers_.size()); }
+
+  /// Strands taken from another worker's queue.
+  uint64 get_steal_count() const { return steals_; }
+
+private:
+  friend class TaskStrand;
+
+  struct Worker
+  {
+    Worker() : thread(nullptr) { }
+
+    std::mutex lock;
+    std::deque<std::shared_ptr<TaskStrand>> strands;
+    std::thread* thread;
+  };
+
+  void schedule(std::shared_ptr<TaskStrand>&& strand);
+  std::shared_ptr<TaskStrand> take(uint32 index);
+  void run(uint32 index);
+
+  std::vector<Worker*> workers_;
+  uint32 batch_size_;
+  std::atomic<bool> stopped_;
+  std::atomic<uint32> next_worker_;
+  std::atomic<uint32> pending_;
+  std::atomic<uint32> idle_workers_;
+  std::atomic<uint64> steals_;
+  std::mutex sleep_lock_;
+  std::condition_variable wake_;
+};
+
+#endif //__task_pool_h__
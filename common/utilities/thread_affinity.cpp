@@ -0,0 +1,95 @@
+#include "thread_affinity.h"
+#include "common_util.h"
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+bool set_current_thread_affinity(std::vector<uint32> const& cpus)
+{
+  if (cpus.empty())
+    return true;
+
+#ifdef _WIN32
+  DWORD_PTR mask = 0;
+  for (uint32 cpu : cpus)
+    if (cpu < sizeof(DWORD_PTR) * 8)
+      mask |= DWORD_PTR(1) << cpu;
+  return mask && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (uint32 cpu : cpus)
+    if (cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+std::vector<uint32> get_numa_node_cpus(uint32 node)
+{
+  std::vector<uint32> cpus;
+#ifdef __linux__
+  // cpulist format: "0-3,8-11"
+  std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+  std::string list;
+  if (!std::getline(file, list))
+    return cpus;
+
+  Tokenizer ranges(list, ',', 0, false);
+  for (char const* range : ranges)
+  {
+    char* end = nullptr;
+    uint32 first = uint32(strtoul(range, &end, 10));
+    uint32 last = (*end == '-') ? uint32(strtoul(end + 1, nullptr, 10)) : first;
+    for (uint32 cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+  }
+#else
+  (void)node;
+#endif
+  return cpus;
+}
+
+int32 get_memory_numa_node(void const* ptr)
+{
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+  // MPOL_F_NODE | MPOL_F_ADDR, no libnuma dependency for numaif.h
+  int node = -1;
+  if (syscall(SYS_get_mempolicy, &node, nullptr, 0UL, const_cast<void*>(ptr), 1UL | 2UL) == 0)
+    return int32(node);
+#else
+  (void)ptr;
+#endif
+  return -1;
+}
+
+uint64 get_current_thread_cpu_us()
+{
+#ifdef _WIN32
+  FILETIME creation, exit, kernel, user;
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+    return 0;
+  // 100ns units
+  uint64 kernel_time = (uint64(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+  uint64 user_time = (uint64(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+  return (kernel_time + user_time) / 10;
+#elif defined(__linux__)
+  timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    return 0;
+  return uint64(ts.tv_sec) * 1000000 + uint64(ts.tv_nsec) / 1000;
+#else
+  return 0;
+#endif
+}
@@ -0,0 +1,19 @@
+#ifndef __thread_affinity_h__
+#define __thread_affinity_h__
+#include "define.h"
+#include <vector>
+
+/// Pins the calling thread to the given logical cpus, an empty list is a no-op.
+/// Returns false if the platform does not support it or the call failed.
+bool set_current_thread_affinity(std::vector<uint32> const& cpus);
+
+/// Logical cpus of a NUMA node (Linux sysfs), empty if the node is unknown.
+std::vector<uint32> get_numa_node_cpus(uint32 node);
+
+/// NUMA node of the (touched) page holding ptr, -1 where unknown.
+int32 get_memory_numa_node(void const* ptr);
+
+/// CPU time consumed by the calling thread in microseconds, 0 where unsupported.
+uint64 get_current_thread_cpu_us();
+
+#endif //__thread_affinity_h__
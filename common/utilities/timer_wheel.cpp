@@ -0,0 +1,78 @@
+#include "timer_wheel.h"
+
+TimerWheel::TimerWheel(uint32 tick_ms, uint64 now_ms) : tick_ms_(tick_ms ? tick_ms : 1),
+  start_ms_(now_ms), current_tick_(0)
+{
+}
+
+void TimerWheel::schedule(Timer& timer, uint32 delay_ms)
+{
+  uint64 ticks = (uint64(delay_ms) + tick_ms_ - 1) / tick_ms_;
+  timer.cancel();
+  // current_tick_ is the next tick to process, never place a timer in a slot being fired
+  timer.expires_ = current_tick_ + (ticks ? ticks : 1);
+  add(timer);
+}
+
+void TimerWheel::advance(uint64 now_ms)
+{
+  if (now_ms < start_ms_)
+    return;
+
+  uint64 target_tick = (now_ms - start_ms_) / tick_ms_;
+  while (current_tick_ <= target_tick)
+  {
+    uint32 index = uint32(current_tick_ & SLOT_MASK);
+    for (uint32 level = 1; index == 0 && level < LEVEL_COUNT; ++level)
+    {
+      index = uint32((current_tick_ >> (level * SLOT_BITS)) & SLOT_MASK);
+      cascade(level, index);
+    }
+
+    // detach the slot first so callbacks may freely cancel or reschedule timers
+    Link expired;
+    Link& slot = slots_[0][current_tick_ & SLOT_MASK];
+    if (slot.linked())
+    {
+      expired.next = slot.next;
+      expired.prev = slot.prev;
+      expired.next->prev = &expired;
+      expired.prev->next = &expired;
+      slot.prev = slot.next = &slot;
+    }
+
+    ++current_tick_;
+    while (expired.linked())
+    {
+      Timer* timer = static_cast<Timer*>(expired.next);
+      timer->unlink();
+      if (timer->callback_)
+        timer->callback_();
+    }
+  }
+}
+
+void TimerWheel::add(Timer& timer)
+{
+  uint64 delta = timer.expires_ - current_tick_;
+  uint32 level = 0;
+  while (level + 1 < LEVEL_COUNT && delta >= (uint64(1) << ((level + 1) * SLOT_BITS)))
+    ++level;
+
+  if (level + 1 == LEVEL_COUNT && delta >= (uint64(1) << (LEVEL_COUNT * SLOT_BITS)))
+    timer.expires_ = current_tick_ + (uint64(1) << (LEVEL_COUNT * SLOT_BITS)) - 1;
+
+  uint32 index = uint32((timer.expires_ >> (level * SLOT_BITS)) & SLOT_MASK);
+  timer.link_before(&slots_[level][index]);
+}
+
+void TimerWheel::cascade(uint32 level, uint32 index)
+{
+  Link& slot = slots_[level][index];
+  while (slot.linked())
+  {
+    Timer* timer = static_cast<Timer*>(slot.next);
+    timer->unlink();
+    add(*timer);
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef __timer_wheel_h__
+#define __timer_wheel_h__
+#include "define.h"
+#include <functional>
+
+/**
+  * @name   TimerWheel
+  * @brief  Hierarchical timing wheel (4 levels of 64 slots). schedule() and cancel() are O(1),
+  *         advance() fires every timer whose tick has passed and cascades the upper levels.
+  *         Not thread-safe, a wheel and its timers belong to one thread.
+*/
+class TimerWheel
+{
+  struct Link
+  {
+    Link() : prev(this), next(this) { }
+
+    bool linked() const { return next != this; }
+
+    void link_before(Link* head)
+    {
+      prev = head->prev;
+      next = head;
+      head->prev->next = this;
+      head->prev = this;
+    }
+
+    void unlink()
+    {
+      prev->next = next;
+      next->prev = prev;
+      prev = next = this;
+    }
+
+    Link* prev;
+    Link* next;
+  };
+
+public:
+  static uint32 const SLOT_BITS = 6;
+  static uint32 const SLOT_COUNT = 1 << SLOT_BITS;
+  static uint32 const SLOT_MASK = SLOT_COUNT - 1;
+  static uint32 const LEVEL_COUNT = 4;
+
+  class Timer : private Link
+  {
+  public:
+    Timer() : expires_(0) { }
+    ~Timer() { cancel(); }
+
+    Timer(Timer const&) = delete;
+    Timer& operator=(Timer const&) = delete;
+
+    void set_callback(std::function<void()> callback) { callback_ = std::move(callback); }
+    bool is_scheduled() const { return linked(); }
+    void cancel() { unlink(); }
+
+  private:
+    friend class TimerWheel;
+    uint64 expires_;
+    std::function<void()> callback_;
+  };
+
+  TimerWheel(uint32 tick_ms, uint64 now_ms);
+
+  TimerWheel(TimerWheel const&) = delete;
+  TimerWheel& operator=(TimerWheel const&) = delete;
+
+  /// (Re)arms timer to fire delay_ms from the wheel's current time, rounded up to a whole tick.
+  void schedule(Timer& timer, uint32 delay_ms);
+
+  /// Fires every timer due at or before now_ms.
+  void advance(uint64 now_ms);
+
+  uint32 get_tick_ms() const { return tick_ms_; }
+
+private:
+  void add(Timer& timer);
+  void cascade(uint32 level, uint32 index);
+
+  uint32 tick_ms_;
+  uint64 start_ms_;
+  uint64 current_tick_;
+  Link slots_[LEVEL_COUNT][SLOT_COUNT];
+};
+
+#endif /* __timer_wheel_h__ */
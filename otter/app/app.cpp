@@ -1,8 +1,27 @@
 #include "app.h"
+#include "placement.h"
 #include <algorithm>
+#include <cstring>
+#include <fstream>
+
+/// Yaml file with the placement section, "--conf <file>" on the command line overrides it.
+#define OTTER_DEFAULT_CONF "otter.yaml"
+
+static const char* find_conf_file(int argc, char** argv)
+{
+  for (int i = 1; i + 1 < argc; ++i)
+    if (std::strcmp(argv[i], "--conf") == 0)
+      return argv[i + 1];
+
+  return std::ifstream(OTTER_DEFAULT_CONF).good() ? OTTER_DEFAULT_CONF : nullptr;
+}
 
 void App::app_main(int argc, char** argv)
 {
+  // app.lua starts the log and network threads, they are pinned from this config when created
+  const char* conffile = find_conf_file(argc, argv);
+  if (conffile && init_placement_conf(conffile))
+    apply_main_thread_placement();
   luaapp_.open_libraries();
   sol::table argv_table = luaapp_.create_table();
   std::for_each(argv, argv + argc,
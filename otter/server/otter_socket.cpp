@@ -1,7 +1,89 @@
 #include "otter_socket.h"
 #include "log.h"
 
+/// A client with this much unread output is considered dead.
+#define OTTER_WRITE_QUEUE_HIGH (4 * 1024 * 1024)
+#define OTTER_WRITE_QUEUE_LOW (1024 * 1024)
+
+TaskPool* OtterSocket::task_pool_ = nullptr;
+
 void OtterSocket::start()
 {
+	set_write_queue_limits(OTTER_WRITE_QUEUE_HIGH, OTTER_WRITE_QUEUE_LOW, WRITE_QUEUE_DISCONNECT);
+	if (task_pool_)
+		strand_ = task_pool_->make_strand();
+	async_read();
+}
+
+bool OtterSocket::update()
+{
+	return Socket<OtterSocket>::update();
+}
+
+void OtterSocket::on_close()
+{
+	LOG_DEBUG("network", "OtterSocket::on_close {}:{}",
+		get_remote_ipaddress().to_string().c_str(), get_remote_port());
+}
+
+void OtterSocket::on_write_queue_watermark(bool high, std::size_t queued_bytes)
+{
+	if (high)
+		LOG_WARN("network", "OtterSocket: client {} is not reading, {} bytes queued",
+			get_remote_ipaddress().to_string().c_str(), queued_bytes);
+	else
+		LOG_DEBUG("network", "OtterSocket: client {} write queue drained to {} bytes",
+			get_remote_ipaddress().to_string().c_str(), queued_bytes);
+}
+
+void OtterSocket::read_handler()
+{
+	if (!is_open())
+		return;
+
+	FrameDecodeResult result = decoder_.decode(get_read_buffer(),
+		[this](FrameView const& packet)
+		{
+			return handle_packet(packet);
+		});
+
+	if (result == FRAME_DECODE_INVALID)
+	{
+		LOG_ERROR("network", "OtterSocket::read_handler: client {} sent an oversized packet, closing",
+			get_remote_ipaddress().to_string().c_str());
+		close_socket();
+		return;
+	}
+
+	if (result == FRAME_DECODE_STOPPED)
+		return;
+
 	async_read();
-}
\ No newline at end of file
+}
+
+bool OtterSocket::handle_packet(FrameView const& packet)
+{
+	if (!strand_)
+	{
+		process_packet(ByteBufferView(packet.data, packet.size));
+		return is_open();
+	}
+
+	// the frame points into the read buffer, the strand gets its own copy
+	MessageBuffer buffer(packet.size);
+	buffer.write(packet.data, packet.size);
+	std::shared_ptr<OtterSocket> self = shared_from_this();
+	strand_->post([self, buffer = std::move(buffer)]()
+		{
+			self->process_packet(ByteBufferView(buffer));
+		});
+	return is_open();
+}
+
+void OtterSocket::process_packet(ByteBufferView packet)
+{
+	// only read by LOG_TRACE, which release builds compile out
+	(void)packet;
+	LOG_TRACE("network", "OtterSocket::process_packet {} bytes from {}",
+		packet.size(), get_remote_ipaddress().to_string().c_str());
+}
@@ -1,6 +1,12 @@
 #ifndef __otter_socket_h__
 #define __otter_socket_h__
 #include "network/socket.h"
+#include "network/frame_decoder.h"
+#include "task_pool.h"
+#include "byte_buffer_view.h"
+
+/// Largest client packet payload, a bigger length prefix closes the connection.
+#define OTTER_MAX_PACKET_SIZE (8 * 1024)
 
 class OtterSocket : public Socket<OtterSocket>
 {
@@ -16,8 +22,21 @@ public:
 	void on_close() override;
 	void read_handler() override;
 
+	/// Packets of sockets started afterwards are copied to a per-socket strand of pool and
+	/// handled there instead of on the network thread. nullptr (default) handles them inline.
+	static void set_task_pool(TaskPool* pool) { task_pool_ = pool; }
+
+protected:
+	void on_write_queue_watermark(bool high, std::size_t queued_bytes) override;
+
+	/// Handles one complete client packet, on the network thread or on the socket's strand.
+	virtual void process_packet(ByteBufferView packet);
+
 private:
-	MessageBuffer head_buffer_;
-	MessageBuffer packet_buffer_;
+	bool handle_packet(FrameView const& packet);
+
+	FrameDecoder<uint16> decoder_{ OTTER_MAX_PACKET_SIZE };
+	std::shared_ptr<TaskStrand> strand_;
+	static TaskPool* task_pool_;
 };
 #endif //__otter_socket_h__
@@ -0,0 +1,133 @@
+#include "network/socket.h"
+#include "network/socket_mgr.h"
+#include "spdlog/sinks/null_sink.h"
+#include <boost/asio/write.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+  * Accept-to-first-read latency: a client connects and writes its connect time right away,
+  * the server socket measures when its first read_handler() sees it. Covers the accept,
+  * the thread pick, on_socket_open, start() on the owning thread and the first async_read.
+  *
+  *   bench_accept [connections] [network threads] [port]
+  *
+  * Each mode listens on its own port (port, port + 1), the sockets closed by the first one
+  * keep theirs bound for a while.
+  *
+  * shared:     one acceptor, sockets accepted onto the least loaded thread's io_context
+  * reuseport:  one SO_REUSEPORT acceptor per network thread (set_reuse_port)
+*/
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  std::mutex latency_lock;
+  std::vector<int64> latencies_ns;
+
+  class BenchSocket : public Socket<BenchSocket>
+  {
+  public:
+    using Socket<BenchSocket>::Socket;
+
+    void start() override { async_read(); }
+
+  protected:
+    void read_handler() override
+    {
+      MessageBuffer& buffer = get_read_buffer();
+      if (buffer.get_active_size() < sizeof(int64))
+      {
+        async_read();
+        return;
+      }
+
+      int64 connected;
+      std::memcpy(&connected, buffer.get_read_pointer(), sizeof(connected));
+      int64 now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+      {
+        std::lock_guard<std::mutex> lock(latency_lock);
+        latencies_ns.push_back(now - connected);
+      }
+      buffer.read_completed(buffer.get_active_size());
+    }
+  };
+
+  class BenchSocketMgr : public TCPSocketMgr<BenchSocket>
+  {
+  public:
+    explicit BenchSocketMgr(bool reuse_port) { set_reuse_port(reuse_port); }
+
+  protected:
+    IONetworkThread<BenchSocket>* start_threads() const override
+    {
+      return new IONetworkThread<BenchSocket>[thread_count_];
+    }
+  };
+
+  bool run(char const* name, bool reuse_port, uint32 connections, int threads, uint16 port)
+  {
+    latencies_ns.clear();
+    common::asio::IoContext io_context;
+    BenchSocketMgr mgr(reuse_port);
+    if (!mgr.start_network(io_context, "127.0.0.1", port, threads))
+      return false;
+    std::thread acceptor_thread([&io_context]() { io_context.run(); });
+
+    boost::asio::io_context client_context;
+    tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+    std::vector<tcp::socket> clients;
+    clients.reserve(connections);
+    for (uint32 i = 0; i < connections; ++i)
+    {
+      clients.emplace_back(client_context);
+      clients.back().connect(endpoint);
+      int64 now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+      boost::asio::write(clients.back(), boost::asio::buffer(&now, sizeof(now)));
+    }
+
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    std::size_t received = 0;
+    while (received < connections && Clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      std::lock_guard<std::mutex> lock(latency_lock);
+      received = latencies_ns.size();
+    }
+
+    mgr.stop_network();
+    io_context.stop();
+    acceptor_thread.join();
+
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+    if (latencies_ns.empty())
+      return false;
+
+    std::printf("%-10s %6u/%u   p50 %8.1f us   p99 %8.1f us\n", name, uint32(latencies_ns.size()), connections,
+      latencies_ns[latencies_ns.size() / 2] / 1000.0, latencies_ns[latencies_ns.size() * 99 / 100] / 1000.0);
+    return true;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  uint32 connections = argc > 1 ? uint32(std::strtoul(argv[1], nullptr, 10)) : 1000;
+  int threads = argc > 2 ? std::atoi(argv[2]) : 4;
+  uint16 port = argc > 3 ? uint16(std::atoi(argv[3])) : 18765;
+  spdlog::null_logger_mt("network");
+
+  if (!run("shared", false, connections, threads, port))
+    std::printf("shared acceptor failed on port %u\n", port);
+#ifdef SO_REUSEPORT
+  if (!run("reuseport", true, connections, threads, uint16(port + 1)))
+    std::printf("reuseport acceptors failed on port %u\n", port + 1);
+#endif
+  return 0;
+}
@@ -0,0 +1,196 @@
+#include "byte_buffer_schema.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+/**
+  * Append cost per field: 500 uint32 plus 100 uint8 fields into a ByteBuffer reserved at
+  * 4 KiB, the shape of a large update packet. Build with optimizations (and NDEBUG, which
+  * compiles the append sanity checks out).
+  *
+  *   bench_byte_buffer [iterations]
+  *
+  * legacy:       the pre reserve_append path, an out-of-line vector insert with three
+  *               ASSERTs per field, kept here as the baseline
+  * operator<<:   ByteBuffer::operator<< (append over reserve_append)
+  * write_raw:    one reserve_append per packet, fields stored through the raw cursor
+  *
+  * Schema cost per struct: 100 MoveInfo (eight fixed fields, a packed guid and a name) into
+  * and out of one packet.
+  *
+  * operator<<:     the hand written operator<< / operator>> chain
+  * schema:         schema_write / schema_read over the struct's ByteBufferSchema
+*/
+
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE
+#endif
+
+namespace
+{
+  uint32 const UINT32_FIELDS = 500;
+  uint32 const UINT8_FIELDS = 100;
+  uint32 const FIELDS = UINT32_FIELDS + UINT8_FIELDS;
+  std::size_t const RESERVE = 4096;
+  uint32 const STRUCTS = 100;
+
+  struct MoveInfo
+  {
+    uint32 id;
+    uint32 flags;
+    uint32 time;
+    float x, y, z, orientation;
+    uint16 fall_time;
+    uint64 guid;
+    std::string name;
+  };
+
+  /// ByteBuffer's append before reserve_append.
+  class LegacyBuffer
+  {
+  public:
+    LegacyBuffer() : wpos_(0) { storage_.reserve(RESERVE); }
+
+    template<typename T>
+    void append(T value)
+    {
+      endian_convert(value);
+      append((uint8 const*)&value, sizeof(value));
+    }
+
+    BENCH_NOINLINE void append(uint8 const* src, std::size_t cnt)
+    {
+      ASSERT(src, "Attempted to put a NULL-pointer in ByteBuffer (pos: " SZFMTD " size: " SZFMTD ")", wpos_, storage_.size());
+      ASSERT(cnt, "Attempted to put a zero-sized value in ByteBuffer (pos: " SZFMTD " size: " SZFMTD ")", wpos_, storage_.size());
+      ASSERT(storage_.size() < 10000000);
+      storage_.insert(storage_.begin() + wpos_, src, src + cnt);
+      wpos_ += cnt;
+    }
+
+    std::size_t size() const { return storage_.size(); }
+    uint8 const* contents() const { return storage_.data(); }
+
+  private:
+    std::size_t wpos_;
+    SlabByteVector storage_;
+  };
+
+  /// ns per unit, a unit being a field or a struct.
+  template<typename Fill>
+  double run(uint32 iterations, uint32 units, Fill&& fill, uint64& sink)
+  {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32 i = 0; i < iterations; ++i)
+      sink += fill(i);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return double(ns) / (double(iterations) * units);
+  }
+
+  MoveInfo make_move(uint32 i)
+  {
+    MoveInfo move = { i, 0x10, i * 3, 1.0f, 2.0f, 3.0f, 0.5f, uint16(i), UI64LIT(0x0000120000340000) | i, "player" };
+    return move;
+  }
+}
+
+template<> struct ByteBufferSchema<MoveInfo> : SchemaFields<
+  SCHEMA_FIELD(MoveInfo, id), SCHEMA_FIELD(MoveInfo, flags), SCHEMA_FIELD(MoveInfo, time),
+  SCHEMA_FIELD(MoveInfo, x), SCHEMA_FIELD(MoveInfo, y), SCHEMA_FIELD(MoveInfo, z),
+  SCHEMA_FIELD(MoveInfo, orientation), SCHEMA_FIELD(MoveInfo, fall_time),
+  SCHEMA_PACKED_UINT64(MoveInfo, guid), SCHEMA_FIELD(MoveInfo, name)> { };
+
+static void stream_write(ByteBuffer& buffer, MoveInfo const& move)
+{
+  buffer << move.id << move.flags << move.time << move.x << move.y << move.z << move.orientation << move.fall_time;
+  buffer.append_packed_uint64(move.guid);
+  buffer << move.name;
+}
+
+static void stream_read(ByteBuffer& buffer, MoveInfo& move)
+{
+  buffer >> move.id >> move.flags >> move.time >> move.x >> move.y >> move.z >> move.orientation >> move.fall_time;
+  buffer.read_packed_uint64(move.guid);
+  buffer >> move.name;
+}
+
+int main(int argc, char** argv)
+{
+  uint32 iterations = argc > 1 ? uint32(std::strtoul(argv[1], nullptr, 10)) : 20000;
+  uint64 sink = 0;
+
+  double legacy = run(iterations, FIELDS, [](uint32 i)
+    {
+      LegacyBuffer buffer;
+      for (uint32 f = 0; f < UINT32_FIELDS; ++f)
+      {
+        buffer.append<uint32>(f + i);
+        if (f % 5 == 0)
+          buffer.append<uint8>(uint8(f));
+      }
+      return buffer.size() + buffer.contents()[7];
+    }, sink);
+
+  double stream = run(iterations, FIELDS, [](uint32 i)
+    {
+      ByteBuffer buffer(RESERVE);
+      for (uint32 f = 0; f < UINT32_FIELDS; ++f)
+      {
+        buffer << uint32(f + i);
+        if (f % 5 == 0)
+          buffer << uint8(f);
+      }
+      return buffer.size() + buffer.contents()[7];
+    }, sink);
+
+  double raw = run(iterations, FIELDS, [](uint32 i)
+    {
+      ByteBuffer buffer(RESERVE);
+      uint8* cursor = buffer.reserve_append(UINT32_FIELDS * sizeof(uint32) + UINT8_FIELDS * sizeof(uint8));
+      for (uint32 f = 0; f < UINT32_FIELDS; ++f)
+      {
+        cursor = ByteBuffer::write_raw(cursor, uint32(f + i));
+        if (f % 5 == 0)
+          cursor = ByteBuffer::write_raw(cursor, uint8(f));
+      }
+      return buffer.size() + buffer.contents()[7];
+    }, sink);
+
+  std::printf("legacy      %6.2f ns/field\n", legacy);
+  std::printf("operator<<  %6.2f ns/field\n", stream);
+  std::printf("write_raw   %6.2f ns/field\n", raw);
+
+  MoveInfo moves[STRUCTS];
+  for (uint32 m = 0; m < STRUCTS; ++m)
+    moves[m] = make_move(m);
+
+  double stream_struct = run(iterations, STRUCTS, [&moves](uint32 i)
+    {
+      ByteBuffer buffer(RESERVE);
+      for (MoveInfo const& move : moves)
+        stream_write(buffer, move);
+      MoveInfo read;
+      for (uint32 m = 0; m < STRUCTS; ++m)
+        stream_read(buffer, read);
+      return buffer.size() + read.id + i;
+    }, sink);
+
+  double schema_struct = run(iterations, STRUCTS, [&moves](uint32 i)
+    {
+      ByteBuffer buffer(RESERVE);
+      for (MoveInfo const& move : moves)
+        schema_write(buffer, move);
+      MoveInfo read;
+      for (uint32 m = 0; m < STRUCTS; ++m)
+        schema_read(buffer, read);
+      return buffer.size() + read.id + i;
+    }, sink);
+
+  std::printf("operator<<  %6.2f ns/struct (write + read)\n", stream_struct);
+  std::printf("schema      %6.2f ns/struct (write + read)\n", schema_struct);
+  std::printf("(sink %llu)\n", (unsigned long long)sink);
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include "byte_buffer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/**
+  * Read cost per record: 200 records of a name plus a packed guid, the shape of a chat or
+  * roster packet. Build with optimizations (and NDEBUG).
+  *
+  *   bench_byte_buffer_read [iterations]
+  *
+  * bytewise:  the former readers, one checked read<char>() per string byte and one
+  *            read<uint8>() per guid mask bit, kept here as the baseline
+  * current:   operator>>(std::string) over the memchr scan and read_packed_uint64 over
+  *            ByteBuffer::unpack_uint64
+*/
+
+namespace
+{
+  uint32 const RECORDS = 200;
+
+  void bytewise_string(ByteBuffer& buffer, std::string& value)
+  {
+    value.clear();
+    while (buffer.rpos() < buffer.size())
+    {
+      char c = buffer.read<char>();
+      if (c == 0)
+        break;
+      value += c;
+    }
+  }
+
+  void bytewise_packed_uint64(ByteBuffer& buffer, uint64& guid)
+  {
+    guid = 0;
+    uint8 mask = buffer.read<uint8>();
+    for (uint32 i = 0; i < 8; ++i)
+      if (mask & (uint8(1) << i))
+        guid |= uint64(buffer.read<uint8>()) << (i * 8);
+  }
+
+  template<typename Read>
+  double run(uint32 iterations, ByteBuffer& packet, Read&& read, uint64& sink)
+  {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32 i = 0; i < iterations; ++i)
+    {
+      packet.rpos(0);
+      sink += read(packet);
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return double(ns) / (double(iterations) * RECORDS);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  uint32 iterations = argc > 1 ? uint32(std::strtoul(argv[1], nullptr, 10)) : 20000;
+  uint64 sink = 0;
+
+  ByteBuffer packet;
+  for (uint32 r = 0; r < RECORDS; ++r)
+  {
+    packet << (std::string("player_name_") + std::to_string(r));
+    packet.append_packed_uint64(UI64LIT(0x0000120000340000) | r);
+  }
+
+  double bytewise = run(iterations, packet, [](ByteBuffer& buffer)
+    {
+      std::string name;
+      uint64 guid, sum = 0;
+      for (uint32 r = 0; r < RECORDS; ++r)
+      {
+        bytewise_string(buffer, name);
+        bytewise_packed_uint64(buffer, guid);
+        sum += name.size() + guid;
+      }
+      return sum;
+    }, sink);
+
+  double current = run(iterations, packet, [](ByteBuffer& buffer)
+    {
+      std::string name;
+      uint64 guid, sum = 0;
+      for (uint32 r = 0; r < RECORDS; ++r)
+      {
+        buffer >> name;
+        buffer.read_packed_uint64(guid);
+        sum += name.size() + guid;
+      }
+      return sum;
+    }, sink);
+
+  std::printf("bytewise  %6.2f ns/record\n", bytewise);
+  std::printf("current   %6.2f ns/record\n", current);
+  std::printf("(sink %llu)\n", (unsigned long long)sink);
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include "define.h"
+#include "mpsc_queue.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+  * Cost per packet of handing packets from producer threads to one consumer, the way game
+  * logic feeds Socket::queue_packet and the network thread drains it. Build with
+  * optimizations.
+  *
+  *   bench_mpsc_queue [items]
+  *
+  * mutex:  std::queue behind a std::mutex, the consumer takes the lock per dequeue
+  * mpsc:   MPSCQueue, the queue behind Socket::queue_packet
+  *
+  * Each row runs 1, 4 and 16 producers splitting the same number of items.
+*/
+
+namespace
+{
+  /// Stands in for a SocketWriteBuffer, a small movable handle to a heap payload.
+  typedef std::unique_ptr<uint64> Packet;
+
+  class MutexQueue
+  {
+  public:
+    void enqueue(Packet&& packet)
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      queue_.push(std::move(packet));
+    }
+
+    bool dequeue(Packet& packet)
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (queue_.empty())
+        return false;
+
+      packet = std::move(queue_.front());
+      queue_.pop();
+      return true;
+    }
+
+  private:
+    std::mutex lock_;
+    std::queue<Packet> queue_;
+  };
+
+  template<typename Queue>
+  double run(uint32 producer_count, uint32 items, uint64& sink)
+  {
+    Queue queue;
+    uint32 per_producer = items / producer_count;
+    uint32 total = per_producer * producer_count;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (uint32 p = 0; p < producer_count; ++p)
+      producers.emplace_back([&queue, per_producer]()
+        {
+          for (uint32 i = 0; i < per_producer; ++i)
+            queue.enqueue(Packet(new uint64(i)));
+        });
+
+    Packet packet;
+    for (uint32 received = 0; received < total;)
+    {
+      if (!queue.dequeue(packet))
+        continue;
+
+      sink += *packet;
+      ++received;
+    }
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    for (std::thread& producer : producers)
+      producer.join();
+    return double(ns) / double(total);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  uint32 items = argc > 1 ? uint32(std::strtoul(argv[1], nullptr, 10)) : 1600000;
+  uint64 sink = 0;
+
+  std::printf("producers   mutex ns/item   mpsc ns/item\n");
+  for (uint32 producers : { 1u, 4u, 16u })
+  {
+    double locked = run<MutexQueue>(producers, items, sink);
+    double mpsc = run<MPSCQueue<Packet>>(producers, items, sink);
+    std::printf("%9u   %13.2f   %12.2f\n", producers, locked, mpsc);
+  }
+
+  std::printf("(sink %llu)\n", (unsigned long long)sink);
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include "byte_buffer.h"
+#include "byte_buffer_reader.h"
+#include "byte_buffer_view.h"
+#include "test_util.h"
+#include <string>
+
+/// Every packed guid mask decodes to the value it was packed from, through unpack_uint64
+/// (BMI2 or scalar, whichever this CPU selects) and through read_packed_uint64.
+static void test_packed_uint64()
+{
+  for (uint32 mask = 0; mask < 256; ++mask)
+  {
+    uint64 value = 0;
+    for (uint32 i = 0; i < 8; ++i)
+      if (mask & (1u << i))
+        value |= uint64(0x11 * (i + 1)) << (i * 8);
+
+    ByteBuffer buffer;
+    buffer.append_packed_uint64(value);
+    TEST_CHECK(buffer.contents()[0] == mask);
+    TEST_CHECK(buffer.size() == 1 + ByteBuffer::packed_uint64_size(uint8(mask)));
+    TEST_CHECK(ByteBuffer::unpack_uint64(uint8(mask), buffer.contents() + 1) == value);
+
+    uint64 read = ~uint64(0);
+    buffer.read_packed_uint64(read);
+    TEST_CHECK(read == value);
+    TEST_CHECK(buffer.rpos() == buffer.size());
+  }
+
+  // the mask announces more bytes than the packet holds
+  ByteBuffer truncated;
+  truncated << uint8(0xFF) << uint32(1);
+  uint64 guid = 0;
+  bool thrown = false;
+  try
+  {
+    truncated.read_packed_uint64(guid);
+  }
+  catch (ByteBufferPositionException const&)
+  {
+    thrown = true;
+  }
+  TEST_CHECK(thrown);
+}
+
+/// C strings shorter and longer than a vector register, empty and unterminated.
+static void test_cstring()
+{
+  std::string const long_name(100, 'x');
+  ByteBuffer buffer;
+  buffer << std::string("name") << std::string() << long_name << uint8(7);
+  buffer.append("tail", 4);
+
+  std::string value;
+  buffer >> value;
+  TEST_CHECK(value == "name");
+  TEST_CHECK(buffer.rpos() == 5);
+  buffer >> value;
+  TEST_CHECK(value.empty());
+  buffer >> value;
+  TEST_CHECK(value == long_name);
+  TEST_CHECK(buffer.read<uint8>() == 7);
+
+  // a missing terminator takes the rest of the data
+  buffer >> value;
+  TEST_CHECK(value == "tail");
+  TEST_CHECK(buffer.rpos() == buffer.size());
+  buffer >> value;
+  TEST_CHECK(value.empty());
+
+  buffer.rpos(0);
+  buffer.read_skip<char*>();
+  TEST_CHECK(buffer.rpos() == 5);
+}
+
+/// Views and readers over a ByteBuffer start at its rpos and leave it alone.
+static void test_views_start_at_rpos()
+{
+  ByteBuffer buffer;
+  buffer << uint32(1) << uint32(2) << uint16(3);
+  TEST_CHECK(buffer.read<uint32>() == 1);
+
+  ByteBufferView view(buffer);
+  TEST_CHECK(view.rpos() == 0);
+  TEST_CHECK(view.size() == sizeof(uint32) + sizeof(uint16));
+  TEST_CHECK(view.read<uint32>() == 2);
+  TEST_CHECK(view.read<uint16>() == 3);
+
+  ByteBufferReader reader(buffer);
+  reader.require(sizeof(uint32) + sizeof(uint16));
+  TEST_CHECK(reader.read<uint32>() == 2);
+  TEST_CHECK(reader.read<uint16>() == 3);
+
+  TEST_CHECK(buffer.rpos() == sizeof(uint32));
+}
+
+int main()
+{
+  test_packed_uint64();
+  test_cstring();
+  test_views_start_at_rpos();
+  return 0;
+}
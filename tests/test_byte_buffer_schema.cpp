@@ -0,0 +1,72 @@
+#include "byte_buffer_schema.h"
+#include "test_util.h"
+#include <cstring>
+
+namespace
+{
+  /// Immutable once built, only ever sent.
+  struct SpawnInfo
+  {
+    uint32 const entry;
+    uint64 const guid;
+    std::string const name;
+    float x;
+  };
+
+  struct MoveInfo
+  {
+    uint32 id;
+    float x, y, z;
+    uint64 guid;
+    std::string name;
+  };
+}
+
+template<> struct ByteBufferSchema<SpawnInfo> : SchemaFields<
+  SCHEMA_FIELD(SpawnInfo, entry), SCHEMA_PACKED_UINT64(SpawnInfo, guid),
+  SCHEMA_FIELD(SpawnInfo, name), SCHEMA_FIELD(SpawnInfo, x)> { };
+
+template<> struct ByteBufferSchema<MoveInfo> : SchemaFields<
+  SCHEMA_FIELD(MoveInfo, id), SCHEMA_FIELD(MoveInfo, x), SCHEMA_FIELD(MoveInfo, y),
+  SCHEMA_FIELD(MoveInfo, z), SCHEMA_PACKED_UINT64(MoveInfo, guid),
+  SCHEMA_FIELD(MoveInfo, name)> { };
+
+static_assert(ByteBufferSchema<SpawnInfo>::fixed_size() == sizeof(uint32) + sizeof(float),
+  "const members have the size of their value type");
+
+/// A struct with const members can be described and written.
+static void test_const_members()
+{
+  SpawnInfo const spawn = { 1234, UI64LIT(0x0000120000340056), "spawn", 2.5f };
+  ByteBuffer written;
+  schema_write(written, spawn);
+
+  ByteBuffer expected;
+  expected << spawn.entry;
+  expected.append_packed_uint64(spawn.guid);
+  expected << spawn.name << spawn.x;
+
+  TEST_CHECK(written.size() == expected.size());
+  TEST_CHECK(schema_size(spawn) == expected.size());
+  TEST_CHECK(std::memcmp(written.contents(), expected.contents(), expected.size()) == 0);
+}
+
+static void test_round_trip()
+{
+  MoveInfo const move = { 7, 1.5f, -2.0f, 3.25f, UI64LIT(0x1200340000560000), "move" };
+  ByteBuffer buffer;
+  schema_write(buffer, move);
+
+  MoveInfo read = MoveInfo();
+  schema_read(buffer, read);
+  TEST_CHECK(read.id == move.id && read.x == move.x && read.y == move.y && read.z == move.z);
+  TEST_CHECK(read.guid == move.guid && read.name == move.name);
+  TEST_CHECK(buffer.rpos() == buffer.size());
+}
+
+int main()
+{
+  test_const_members();
+  test_round_trip();
+  return 0;
+}
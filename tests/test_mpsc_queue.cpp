@@ -0,0 +1,65 @@
+#include "define.h"
+#include "mpsc_queue.h"
+#include "test_util.h"
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  uint32 const PRODUCERS = 4;
+  uint32 const ITEMS_PER_PRODUCER = 50000;
+
+  struct Item
+  {
+    uint32 producer;
+    uint32 sequence;
+  };
+}
+
+/// Producers enqueue while the consumer drains: every item arrives exactly once and the
+/// items of one producer arrive in the order they were enqueued.
+int main()
+{
+  MPSCQueue<std::unique_ptr<Item>> queue;
+  std::vector<std::thread> producers;
+  for (uint32 p = 0; p < PRODUCERS; ++p)
+    producers.emplace_back([&queue, p]()
+      {
+        for (uint32 i = 0; i < ITEMS_PER_PRODUCER; ++i)
+          queue.enqueue(std::unique_ptr<Item>(new Item{ p, i }));
+      });
+
+  std::vector<uint32> next(PRODUCERS, 0);
+  uint32 received = 0;
+  bool ordered = true;
+  std::unique_ptr<Item> item;
+  while (received < PRODUCERS * ITEMS_PER_PRODUCER)
+  {
+    if (!queue.dequeue(item))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    TEST_CHECK(item && item->producer < PRODUCERS);
+    ordered = ordered && item->sequence == next[item->producer];
+    next[item->producer] = item->sequence + 1;
+    ++received;
+  }
+
+  for (std::thread& producer : producers)
+    producer.join();
+
+  TEST_CHECK(ordered);
+  for (uint32 p = 0; p < PRODUCERS; ++p)
+    TEST_CHECK(next[p] == ITEMS_PER_PRODUCER);
+  TEST_CHECK(queue.empty());
+  TEST_CHECK(!queue.dequeue(item));
+
+  // items left behind are destroyed with the queue
+  MPSCQueue<std::unique_ptr<Item>> leftover;
+  leftover.enqueue(std::unique_ptr<Item>(new Item{ 0, 0 }));
+  leftover.enqueue(std::unique_ptr<Item>(new Item{ 0, 1 }));
+  return 0;
+}
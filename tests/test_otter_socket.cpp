@@ -0,0 +1,81 @@
+#include "otter_socket.h"
+#include "spdlog/sinks/null_sink.h"
+#include "test_util.h"
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/write.hpp>
+#include <chrono>
+#include <vector>
+
+namespace
+{
+  /// Records the packets that reached process_packet.
+  class RecordingSocket : public OtterSocket
+  {
+  public:
+    using OtterSocket::OtterSocket;
+
+    std::vector<std::vector<uint8>> packets;
+
+  protected:
+    void process_packet(ByteBufferView packet) override
+    {
+      packets.emplace_back(packet.size());
+      if (!packet.empty())
+        packet.read(packets.back().data(), packet.size());
+    }
+  };
+
+  void write_frame_header(std::vector<uint8>& out, uint16 length)
+  {
+    endian_convert(length);
+    uint8 const* bytes = reinterpret_cast<uint8 const*>(&length);
+    out.insert(out.end(), bytes, bytes + sizeof(length));
+  }
+}
+
+/// A client announcing a packet above OTTER_MAX_PACKET_SIZE is disconnected, the packets
+/// before it are still handled.
+int main()
+{
+  spdlog::null_logger_mt("network");
+
+  boost::asio::io_context io_context;
+  tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+  tcp::socket client(io_context);
+  client.connect(acceptor.local_endpoint());
+  tcp::socket accepted(io_context);
+  acceptor.accept(accepted);
+
+  std::shared_ptr<RecordingSocket> socket = std::make_shared<RecordingSocket>(std::move(accepted));
+  socket->start();
+
+  std::vector<uint8> data;
+  write_frame_header(data, 4);
+  data.insert(data.end(), 4, uint8(0xAB));
+  write_frame_header(data, OTTER_MAX_PACKET_SIZE + 1);
+  data.insert(data.end(), 16, uint8(0xCD));
+  boost::asio::write(client, boost::asio::buffer(data));
+
+  // the server shuts its side down, the client sees the end of the stream
+  boost::system::error_code read_error;
+  bool read_done = false;
+  uint8 reply[16];
+  client.async_read_some(boost::asio::buffer(reply),
+    [&read_error, &read_done](boost::system::error_code error, std::size_t)
+    {
+      read_error = error;
+      read_done = true;
+    });
+  io_context.run_for(std::chrono::seconds(5));
+
+  TEST_CHECK(read_done);
+  TEST_CHECK(read_error == boost::asio::error::eof);
+  TEST_CHECK(!socket->is_open());
+  TEST_CHECK(socket->get_bytes_read() == data.size());
+
+  // the frame ahead of the oversize one was handled, nothing after it
+  TEST_CHECK(socket->packets.size() == 1);
+  TEST_CHECK(socket->packets[0] == std::vector<uint8>(4, uint8(0xAB)));
+  return 0;
+}
@@ -0,0 +1,51 @@
+#include "placement.h"
+#include "thread_affinity.h"
+#include "test_util.h"
+#include <cstdio>
+#include <fstream>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/// The placement section of a yaml file sets the cpus of every thread kind, and the main
+/// thread entry is what the thread ends up pinned to.
+int main()
+{
+  char const* conffile = "test_placement.yaml";
+  {
+    std::ofstream conf(conffile);
+    conf <<
+      "log:\n"
+      "  level: info\n"
+      "placement:\n"
+      "  main_thread: { cpus: [0] }\n"
+      "  log_workers: { cpus: [0] }\n"
+      "  network_threads:\n"
+      "    - { cpus: [0] }\n"
+      "    - { numa_node: 0 }\n";
+  }
+
+  bool loaded = init_placement_conf(conffile);
+  std::remove(conffile);
+  TEST_CHECK(loaded);
+
+  std::vector<uint32> const cpu0 = { 0 };
+  TEST_CHECK(get_main_thread_cpus() == cpu0);
+  TEST_CHECK(get_log_worker_cpus() == cpu0);
+  TEST_CHECK(get_network_thread_cpus().size() == 2);
+  TEST_CHECK(get_network_thread_cpus()[0] == cpu0);
+  TEST_CHECK(get_network_thread_cpus()[1] == get_numa_node_cpus(0));
+
+  TEST_CHECK(!init_placement_conf("missing_placement.yaml"));
+
+#ifdef __linux__
+  TEST_CHECK(apply_main_thread_placement());
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  TEST_CHECK(pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0);
+  TEST_CHECK(CPU_COUNT(&set) == 1);
+  TEST_CHECK(CPU_ISSET(0, &set));
+#endif
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include "ring_message_buffer.h"
+#include "test_util.h"
+#include <cstring>
+
+/// A zero sized buffer maps nothing until it is first used.
+static void test_lazy_allocation()
+{
+  RingMessageBuffer buffer(0);
+  TEST_CHECK(buffer.get_buffer_size() == 0);
+  TEST_CHECK(buffer.get_remaining_space() == 0);
+
+  buffer.ensure_free_space();
+  TEST_CHECK(buffer.get_buffer_size() > 0);
+  TEST_CHECK(buffer.get_remaining_space() == buffer.get_buffer_size());
+
+  RingMessageBuffer defaulted;
+  TEST_CHECK(defaulted.get_buffer_size() == 0);
+}
+
+/// shrink_to(0) of an empty buffer gives the storage back, a second call is a no-op.
+static void test_shrink_to_zero()
+{
+  RingMessageBuffer buffer(4096);
+  uint8 const data[] = { 1, 2, 3, 4 };
+  buffer.write(data, sizeof(data));
+  buffer.read_completed(sizeof(data));
+
+  buffer.shrink_to(0);
+  TEST_CHECK(buffer.get_buffer_size() == 0);
+  TEST_CHECK(buffer.get_active_size() == 0);
+  TEST_CHECK(buffer.get_remaining_space() == 0);
+  TEST_CHECK(!buffer.is_mirrored());
+
+  buffer.shrink_to(0);
+  TEST_CHECK(buffer.get_buffer_size() == 0);
+
+  // reading resumes after the release
+  buffer.ensure_free_space();
+  buffer.write(data, sizeof(data));
+  TEST_CHECK(buffer.get_active_size() == sizeof(data));
+  TEST_CHECK(std::memcmp(buffer.get_read_pointer(), data, sizeof(data)) == 0);
+}
+
+/// An idle mirrored buffer keeps its mapping with the pages freed, growing again reuses it.
+static void test_idle_keeps_mapping()
+{
+  RingMessageBuffer buffer(2 * 4096);
+  if (!buffer.is_mirrored())
+    return;
+
+  uint8* base = buffer.get_write_pointer();
+  uint8 const data[] = { 9, 8, 7 };
+  buffer.write(data, sizeof(data));
+  buffer.read_completed(sizeof(data));
+
+  buffer.shrink_to(0);
+  TEST_CHECK(buffer.get_buffer_size() == 0);
+
+  buffer.resize(4096);
+  TEST_CHECK(buffer.is_mirrored());
+  TEST_CHECK(buffer.get_write_pointer() == base);
+  TEST_CHECK(buffer.get_buffer_size() == 2 * 4096);
+  // the freed pages come back zeroed, in both halves of the ring
+  TEST_CHECK(base[0] == 0 && base[buffer.get_buffer_size()] == 0);
+
+  buffer.write(data, sizeof(data));
+  TEST_CHECK(base[buffer.get_buffer_size() + 1] == data[1]);
+
+  // a grow beyond the parked mapping maps anew
+  buffer.read_completed(sizeof(data));
+  buffer.shrink_to(0);
+  buffer.resize(4 * 4096);
+  TEST_CHECK(buffer.get_buffer_size() == 4 * 4096);
+  TEST_CHECK(buffer.get_remaining_space() == 4 * 4096);
+}
+
+/// Buffered bytes are never dropped by a shrink.
+static void test_shrink_keeps_active_bytes()
+{
+  RingMessageBuffer buffer(3 * 4096);
+  uint8 const data[] = { 5, 6, 7 };
+  buffer.write(data, sizeof(data));
+
+  buffer.shrink_to(0);
+  TEST_CHECK(buffer.get_buffer_size() > 0);
+  TEST_CHECK(buffer.get_buffer_size() < 3 * 4096);
+  TEST_CHECK(buffer.get_active_size() == sizeof(data));
+  TEST_CHECK(std::memcmp(buffer.get_read_pointer(), data, sizeof(data)) == 0);
+}
+
+int main()
+{
+  test_lazy_allocation();
+  test_shrink_to_zero();
+  test_idle_keeps_mapping();
+  test_shrink_keeps_active_bytes();
+  return 0;
+}
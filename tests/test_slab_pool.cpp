@@ -0,0 +1,130 @@
+#include "slab_pool.h"
+#include "test_util.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  std::size_t const BLOCK_SIZE = 1024;
+  std::size_t const BLOCK_COUNT = 64;
+
+  /// Released by static destruction, after the main thread's pool was retired.
+  SlabByteVector late_buffer(BLOCK_SIZE);
+}
+
+/// Blocks allocated on one thread and released on another go back to the allocating thread.
+static void test_cross_thread_release()
+{
+  SlabPool* pool = SlabPool::instance();
+  SlabPool::Stats before = pool->get_stats();
+
+  std::vector<void*> blocks;
+  for (std::size_t i = 0; i < BLOCK_COUNT; ++i)
+    blocks.push_back(SlabPool::allocate(BLOCK_SIZE));
+
+  SlabPool::Stats consumer_stats;
+  std::thread consumer([&blocks, &consumer_stats]()
+    {
+      for (void* block : blocks)
+        SlabPool::deallocate(block, BLOCK_SIZE);
+      consumer_stats = SlabPool::instance()->get_stats();
+    });
+  consumer.join();
+
+  // the consumer kept nothing
+  TEST_CHECK(consumer_stats.cached_bytes == 0);
+  TEST_CHECK(consumer_stats.outstanding_bytes == 0);
+
+  // the producer gets its own blocks back
+  std::vector<void*> reused;
+  for (std::size_t i = 0; i < BLOCK_COUNT; ++i)
+    reused.push_back(SlabPool::allocate(BLOCK_SIZE));
+
+  SlabPool::Stats after = pool->get_stats();
+  TEST_CHECK(after.remote_frees - before.remote_frees == BLOCK_COUNT);
+  TEST_CHECK(after.hits - before.hits == BLOCK_COUNT);
+  TEST_CHECK(after.outstanding_bytes - before.outstanding_bytes == int64(BLOCK_COUNT * BLOCK_SIZE));
+
+  std::sort(blocks.begin(), blocks.end());
+  std::sort(reused.begin(), reused.end());
+  TEST_CHECK(blocks == reused);
+
+  for (void* block : reused)
+    SlabPool::deallocate(block, BLOCK_SIZE);
+}
+
+/// Many threads releasing into one owner concurrently.
+static void test_concurrent_remote_release()
+{
+  uint32 const thread_count = 4;
+  std::vector<std::vector<void*>> blocks(thread_count);
+  for (uint32 t = 0; t < thread_count; ++t)
+    for (std::size_t i = 0; i < BLOCK_COUNT; ++i)
+      blocks[t].push_back(SlabPool::allocate(256));
+
+  std::vector<std::thread> threads;
+  for (uint32 t = 0; t < thread_count; ++t)
+    threads.emplace_back([&blocks, t]()
+      {
+        for (void* block : blocks[t])
+          SlabPool::deallocate(block, 256);
+      });
+  for (std::thread& thread : threads)
+    thread.join();
+
+  SlabPool::Stats before = SlabPool::instance()->get_stats();
+  std::vector<void*> reused;
+  for (std::size_t i = 0; i < thread_count * BLOCK_COUNT; ++i)
+    reused.push_back(SlabPool::allocate(256));
+  TEST_CHECK(SlabPool::instance()->get_stats().hits - before.hits == thread_count * BLOCK_COUNT);
+
+  for (void* block : reused)
+    SlabPool::deallocate(block, 256);
+}
+
+/// A block that outlives its thread is released to the heap, the pool is reused.
+static void test_thread_exit()
+{
+  void* orphan = nullptr;
+  SlabPool* exited_pool = nullptr;
+  std::thread producer([&orphan, &exited_pool]()
+    {
+      orphan = SlabPool::allocate(BLOCK_SIZE);
+      exited_pool = SlabPool::instance();
+    });
+  producer.join();
+
+  SlabPool::deallocate(orphan, BLOCK_SIZE);
+  TEST_CHECK(exited_pool->get_stats().cached_bytes == 0);
+
+  SlabPool* next_pool = nullptr;
+  std::thread next([&next_pool]()
+    {
+      next_pool = SlabPool::instance();
+    });
+  next.join();
+  TEST_CHECK(next_pool == exited_pool);
+}
+
+static void test_large_blocks()
+{
+  std::size_t const size = SlabPool::MAX_BLOCK_SIZE + 1;
+  TEST_CHECK(SlabPool::round_size(size) == size);
+  void* block = SlabPool::allocate(size);
+  std::thread consumer([block, size]()
+    {
+      SlabPool::deallocate(block, size);
+    });
+  consumer.join();
+}
+
+int main()
+{
+  late_buffer[0] = 1;
+  test_cross_thread_release();
+  test_concurrent_remote_release();
+  test_thread_exit();
+  test_large_blocks();
+  return 0;
+}
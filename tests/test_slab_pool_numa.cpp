@@ -0,0 +1,74 @@
+#include "message_buffer.h"
+#include "thread_affinity.h"
+#include "test_util.h"
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+/// A network buffer released on a thread of another NUMA node (a strand copy freed by a
+/// TaskPool worker) is reused by its allocating thread and is still on that thread's node.
+int main()
+{
+  std::vector<uint32> nodes;
+  for (uint32 node = 0; node < 64; ++node)
+    if (!get_numa_node_cpus(node).empty())
+      nodes.push_back(node);
+
+  bool pinned = !nodes.empty();
+  uint32 home = pinned ? nodes.front() : 0;
+  uint32 away = pinned ? nodes.back() : 0;
+  std::size_t const size = 4096;
+
+  int32 first_node = -1;
+  int32 reused_node = -1;
+  bool same_block = false;
+  std::thread producer([&]()
+    {
+      if (pinned)
+        TEST_CHECK(set_current_thread_affinity(get_numa_node_cpus(home)));
+
+      MessageBuffer buffer(size);
+      std::memset(buffer.get_base_pointer(), 1, size);
+      uint8 const* first = buffer.get_base_pointer();
+      first_node = get_memory_numa_node(first);
+
+      // the consumer stays alive meanwhile, so its own cache could still hold the block
+      std::atomic<bool> released(false);
+      std::atomic<bool> done(false);
+      std::thread consumer([&]()
+        {
+          if (pinned)
+            TEST_CHECK(set_current_thread_affinity(get_numa_node_cpus(away)));
+          {
+            MessageBuffer moved(std::move(buffer));
+          }
+          released = true;
+          while (!done)
+            std::this_thread::yield();
+        });
+
+      while (!released)
+        std::this_thread::yield();
+
+      MessageBuffer reused(size);
+      same_block = reused.get_base_pointer() == first;
+      reused_node = get_memory_numa_node(reused.get_base_pointer());
+      done = true;
+      consumer.join();
+    });
+  producer.join();
+
+  TEST_CHECK(same_block);
+  if (first_node < 0)
+  {
+    std::printf("get_mempolicy unavailable, node of the reused block not checked\n");
+    return 0;
+  }
+
+  std::printf("nodes %u -> %u, block on node %d, reused on node %d\n", home, away, first_node, reused_node);
+  if (pinned)
+    TEST_CHECK(first_node == int32(home));
+  TEST_CHECK(reused_node == first_node);
+  return 0;
+}
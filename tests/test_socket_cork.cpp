@@ -0,0 +1,127 @@
+#include "network/socket.h"
+#include "spdlog/sinks/null_sink.h"
+#include "test_util.h"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/read.hpp>
+#include <chrono>
+#include <vector>
+
+namespace
+{
+  class CorkedSocket : public Socket<CorkedSocket>
+  {
+  public:
+    using Socket<CorkedSocket>::Socket;
+    using Socket<CorkedSocket>::underlying_stream;
+
+    void start() override
+    {
+      set_flush_policy(FLUSH_CORKED);
+      set_flush_on_queue(true);
+    }
+
+  protected:
+    void read_handler() override { }
+  };
+
+#ifdef TCP_CORK
+  std::size_t const PACKET_COUNT = 8;
+  std::size_t const PACKET_SIZE = 100;
+
+  void queue_packets(CorkedSocket& socket)
+  {
+    for (std::size_t i = 0; i < PACKET_COUNT; ++i)
+    {
+      MessageBuffer packet(PACKET_SIZE);
+      packet.write_completed(PACKET_SIZE);
+      socket.queue_packet(std::move(packet));
+    }
+  }
+
+  bool is_corked(CorkedSocket& socket)
+  {
+    tcp_cork cork;
+    socket.underlying_stream().get_option(cork);
+    return cork.value();
+  }
+
+  /// Reads for well below the 200ms a cork holds a partial segment back.
+  std::size_t receive(tcp::socket& client, std::size_t size)
+  {
+    client.non_blocking(true);
+    std::vector<uint8> received(size);
+    std::size_t total = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    while (total < received.size() && std::chrono::steady_clock::now() < deadline)
+    {
+      boost::system::error_code error;
+      total += client.read_some(boost::asio::buffer(received.data() + total, received.size() - total), error);
+    }
+    return total;
+  }
+
+  /// A socket owned by a network thread stays corked across the flushes of a tick and is
+  /// uncorked once by update().
+  void test_uncork_on_update()
+  {
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    tcp::socket client(io_context);
+    client.connect(acceptor.local_endpoint());
+    tcp::socket accepted(io_context);
+    acceptor.accept(accepted);
+
+    TimerWheel wheel(10, 0);
+    std::shared_ptr<CorkedSocket> socket = std::make_shared<CorkedSocket>(std::move(accepted));
+    socket->attach_network_thread(io_context, &wheel);
+    socket->start();
+
+    queue_packets(*socket);
+    io_context.run_for(std::chrono::milliseconds(20));
+    queue_packets(*socket);
+    io_context.restart();
+    io_context.run_for(std::chrono::milliseconds(20));
+    TEST_CHECK(socket->get_bytes_written() == 2 * PACKET_COUNT * PACKET_SIZE);
+    TEST_CHECK(is_corked(*socket));
+
+    TEST_CHECK(socket->update());
+    TEST_CHECK(!is_corked(*socket));
+    TEST_CHECK(receive(client, 2 * PACKET_COUNT * PACKET_SIZE) == 2 * PACKET_COUNT * PACKET_SIZE);
+
+    socket->detach_network_thread();
+    socket->close_socket();
+  }
+
+  /// Without a network thread no update() comes, the cork is pulled when the queue drains.
+  void test_uncork_on_drain()
+  {
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    tcp::socket client(io_context);
+    client.connect(acceptor.local_endpoint());
+    tcp::socket accepted(io_context);
+    acceptor.accept(accepted);
+
+    std::shared_ptr<CorkedSocket> socket = std::make_shared<CorkedSocket>(std::move(accepted));
+    socket->start();
+
+    queue_packets(*socket);
+    io_context.run_for(std::chrono::milliseconds(50));
+    TEST_CHECK(socket->get_bytes_written() == PACKET_COUNT * PACKET_SIZE);
+    TEST_CHECK(!is_corked(*socket));
+    TEST_CHECK(receive(client, PACKET_COUNT * PACKET_SIZE) == PACKET_COUNT * PACKET_SIZE);
+
+    socket->close_socket();
+  }
+#endif
+}
+
+int main()
+{
+#ifdef TCP_CORK
+  spdlog::null_logger_mt("network");
+  test_uncork_on_update();
+  test_uncork_on_drain();
+#endif
+  return 0;
+}
@@ -0,0 +1,90 @@
+#include "network/socket.h"
+#include "spdlog/sinks/null_sink.h"
+#include "test_util.h"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/write.hpp>
+#include <chrono>
+#include <string>
+
+namespace
+{
+  std::size_t const LARGE_WRITE = 16 * 1024;
+  std::size_t const SMALL_WRITE = 100;
+
+  /// Consumes everything it reads and counts how often the read buffer got smaller.
+  class SizingSocket : public Socket<SizingSocket>
+  {
+  public:
+    explicit SizingSocket(tcp::socket&& socket) : Socket<SizingSocket>(std::move(socket)),
+      received(0), buffer_size(0), shrinks(0) { }
+
+    void start() override { async_read(); }
+
+    std::size_t received;
+    std::size_t buffer_size;
+    uint32 shrinks;
+
+  protected:
+    void read_handler() override
+    {
+      MessageBuffer& buffer = get_read_buffer();
+      if (buffer.get_buffer_size() < buffer_size)
+        ++shrinks;
+      buffer_size = buffer.get_buffer_size();
+      received += buffer.get_active_size();
+      buffer.read_completed(buffer.get_active_size());
+      async_read();
+    }
+  };
+
+  void send(boost::asio::io_context& io_context, tcp::socket& client, SizingSocket& socket, std::size_t size)
+  {
+    std::string const data(size, 'x');
+    boost::asio::write(client, boost::asio::buffer(data));
+    std::size_t expected = socket.received + size;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (socket.received < expected && std::chrono::steady_clock::now() < deadline)
+      io_context.run_one_for(std::chrono::milliseconds(100));
+    TEST_CHECK(socket.received == expected);
+  }
+}
+
+/// A peer alternating large and small writes keeps its grown read buffer, a run of
+/// READ_BUFFER_SHRINK_READS small reads gives the memory back.
+int main()
+{
+  spdlog::null_logger_mt("network");
+
+  boost::asio::io_context io_context;
+  tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+  tcp::socket client(io_context);
+  client.connect(acceptor.local_endpoint());
+  tcp::socket accepted(io_context);
+  acceptor.accept(accepted);
+
+  std::shared_ptr<SizingSocket> socket = std::make_shared<SizingSocket>(std::move(accepted));
+  socket->start();
+
+  // grow to the large reads first
+  for (uint32 i = 0; i < 4; ++i)
+    send(io_context, client, *socket, LARGE_WRITE);
+  std::size_t const grown = socket->buffer_size;
+  TEST_CHECK(grown >= LARGE_WRITE);
+
+  socket->shrinks = 0;
+  for (uint32 i = 0; i < 2 * READ_BUFFER_SHRINK_READS; ++i)
+  {
+    send(io_context, client, *socket, LARGE_WRITE);
+    send(io_context, client, *socket, SMALL_WRITE);
+  }
+  TEST_CHECK(socket->shrinks == 0);
+  TEST_CHECK(socket->buffer_size == grown);
+
+  for (uint32 i = 0; i < READ_BUFFER_SHRINK_READS + 1; ++i)
+    send(io_context, client, *socket, SMALL_WRITE);
+  TEST_CHECK(socket->shrinks == 1);
+  TEST_CHECK(socket->buffer_size < grown);
+
+  socket->close_socket();
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include "network/socket.h"
+#include "spdlog/sinks/null_sink.h"
+#include "test_util.h"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/write.hpp>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+namespace
+{
+  /// Reads on readiness and records the read buffer size seen by each read_handler() call.
+  template<class ReadBuffer>
+  class ReadinessSocket : public Socket<ReadinessSocket<ReadBuffer>, tcp::socket, ReadBuffer>
+  {
+  public:
+    typedef Socket<ReadinessSocket<ReadBuffer>, tcp::socket, ReadBuffer> Base;
+
+    explicit ReadinessSocket(tcp::socket&& socket) : Base(std::move(socket)), last_buffer_size(0) { }
+
+    void start() override
+    {
+      this->set_read_on_readiness(true);
+      this->async_read();
+    }
+
+    std::string received;
+    std::size_t last_buffer_size;
+
+  protected:
+    void read_handler() override
+    {
+      ReadBuffer& buffer = this->get_read_buffer();
+      last_buffer_size = buffer.get_buffer_size();
+      received.append(reinterpret_cast<char const*>(buffer.get_read_pointer()), buffer.get_active_size());
+      buffer.read_completed(buffer.get_active_size());
+      this->async_read();
+    }
+  };
+
+  template<class ReadBuffer>
+  void run_until_received(boost::asio::io_context& io_context, ReadinessSocket<ReadBuffer> const& socket, std::size_t size)
+  {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (socket.received.size() < size && std::chrono::steady_clock::now() < deadline)
+      io_context.run_one_for(std::chrono::milliseconds(100));
+  }
+
+  /// The waiting socket holds no read buffer, one is taken when data arrives and given back
+  /// once every byte was consumed.
+  template<class ReadBuffer>
+  void test_read_on_readiness()
+  {
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    tcp::socket client(io_context);
+    client.connect(acceptor.local_endpoint());
+    tcp::socket accepted(io_context);
+    acceptor.accept(accepted);
+
+    std::shared_ptr<ReadinessSocket<ReadBuffer>> socket =
+      std::make_shared<ReadinessSocket<ReadBuffer>>(std::move(accepted));
+    socket->start();
+    TEST_CHECK(socket->get_read_buffer().get_buffer_size() == 0);
+
+    std::string const messages[] = { "first message", "second" };
+    std::string expected;
+    for (std::string const& message : messages)
+    {
+      boost::asio::write(client, boost::asio::buffer(message));
+      expected += message;
+      run_until_received(io_context, *socket, expected.size());
+
+      TEST_CHECK(socket->received == expected);
+      TEST_CHECK(socket->last_buffer_size > 0);
+      TEST_CHECK(socket->get_read_buffer().get_buffer_size() == 0);
+    }
+
+    socket->close_socket();
+  }
+}
+
+int main()
+{
+  spdlog::null_logger_mt("network");
+  test_read_on_readiness<MessageBuffer>();
+  test_read_on_readiness<RingMessageBuffer>();
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include "network/socket.h"
+#include "spdlog/sinks/null_sink.h"
+#include "test_util.h"
+#include <boost/asio/io_context.hpp>
+#include <chrono>
+
+namespace
+{
+  std::size_t const HIGH_WATERMARK = 1000;
+  std::size_t const PACKET_SIZE = 300;
+
+  class LimitedSocket : public Socket<LimitedSocket>
+  {
+  public:
+    using Socket<LimitedSocket>::Socket;
+
+    void start() override
+    {
+      set_write_queue_limits(HIGH_WATERMARK, HIGH_WATERMARK / 2, WRITE_QUEUE_DROP);
+      set_flush_on_queue(true);
+    }
+
+  protected:
+    void read_handler() override { }
+  };
+
+  MessageBuffer make_packet()
+  {
+    MessageBuffer packet(PACKET_SIZE);
+    packet.write_completed(PACKET_SIZE);
+    return packet;
+  }
+}
+
+/// A queue that crosses the high watermark and drains through flush_handler, before any
+/// update() tick, takes packets again.
+int main()
+{
+  spdlog::null_logger_mt("network");
+
+  boost::asio::io_context io_context;
+  tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+  tcp::socket client(io_context);
+  client.connect(acceptor.local_endpoint());
+  tcp::socket accepted(io_context);
+  acceptor.accept(accepted);
+
+  std::shared_ptr<LimitedSocket> socket = std::make_shared<LimitedSocket>(std::move(accepted));
+  socket->start();
+
+  // the fourth packet crosses the mark
+  std::size_t const packet_count = HIGH_WATERMARK / PACKET_SIZE + 1;
+  for (std::size_t i = 0; i < packet_count; ++i)
+    socket->queue_packet(make_packet(), false);
+  TEST_CHECK(socket->is_above_high_watermark());
+  TEST_CHECK(socket->get_dropped_packets() == 0);
+
+  io_context.run_for(std::chrono::milliseconds(50));
+  TEST_CHECK(socket->get_bytes_written() == packet_count * PACKET_SIZE);
+  TEST_CHECK(!socket->is_above_high_watermark());
+
+  socket->queue_packet(make_packet(), false);
+  TEST_CHECK(socket->get_dropped_packets() == 0);
+
+  io_context.restart();
+  io_context.run_for(std::chrono::milliseconds(50));
+  TEST_CHECK(socket->get_bytes_written() == (packet_count + 1) * PACKET_SIZE);
+
+  socket->close_socket();
+  return 0;
+}
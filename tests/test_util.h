@@ -0,0 +1,17 @@
+#ifndef __test_util_h__
+#define __test_util_h__
+#include <cstdio>
+#include <cstdlib>
+
+/// Fails the test (exit code 1) with the condition text, in release builds as well.
+#define TEST_CHECK(cond) \
+  do \
+  { \
+    if (!(cond)) \
+    { \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      std::exit(1); \
+    } \
+  } while (0)
+
+#endif //__test_util_h__